@@ -1,56 +1,1203 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MAX_LINE_LENGTH 256
+#define SCORE_BUCKETS 10001   // averages bucketed to 0.01 between 0 and 100
+
+// Subject count and grade cut-offs are fixed at build time
+// (e.g. -DSUBJECT_COUNT=5 -DGRADE_CUTOFFS="{90, 75, 60, 40}"): each student
+// stores exactly SUBJECT_COUNT marks and the kernels are fully unrolled.
+// -DSUBJECT_COUNT=0 builds the fallback instead, which has room for
+// MAX_SUBJECTS marks and takes --subjects and --grades at run time.
+#define MAX_SUBJECTS 12
+#ifndef SUBJECT_COUNT
+#define SUBJECT_COUNT 3
+#endif
+#ifndef GRADE_CUTOFFS
+#define GRADE_CUTOFFS {85, 70, 50, 35}
+#endif
+#define GRADE_LEVELS 5
+
+#if SUBJECT_COUNT < 0 || SUBJECT_COUNT > MAX_SUBJECTS
+#error "SUBJECT_COUNT must be between 1 and MAX_SUBJECTS, or 0 for the run-time fallback build"
+#endif
+
+#if SUBJECT_COUNT > 0
+#define STUDENT_MARKS SUBJECT_COUNT
+#else
+#define STUDENT_MARKS MAX_SUBJECTS
+#endif
 
 // Structure for student information:
 struct Student {
     int rollNumber;
     char studentName[50];
-    float marks[3];
+    float marks[STUDENT_MARKS];
     float totalMarks;
     float averageMarks;
     char grade;
 };
 
+// minimum average for A, B, C and D; anything below is F
+typedef struct {
+    float cutoffs[GRADE_LEVELS - 1];
+} GradeScheme;
+
+const char gradeLetters[] = "ABCDF";
+#if SUBJECT_COUNT > 0
+// constants, so every loop over the subjects has a fixed trip count
+static const int subjectCount = SUBJECT_COUNT;
+static const GradeScheme gradeScheme = {GRADE_CUTOFFS};
+
 // Function to calculate total marks
 float calculateTotal(float marks[]) {
     float total = 0;
-    for (int i = 0; i < 3; i++) {
+    for (int i = 0; i < SUBJECT_COUNT; i++) {
         total += marks[i];
     }
     return total;
 }
+#else
+int subjectCount = 3; // until --subjects says otherwise
+GradeScheme gradeScheme = {GRADE_CUTOFFS};
+
+// total kernels with a constant trip count, fully unrolled by the compiler
+#define DEFINE_TOTAL_KERNEL(count)                      \
+    static inline float calculateTotal##count(const float marks[]) { \
+        float total = 0;                                \
+        for (int i = 0; i < count; i++) {               \
+            total += marks[i];                          \
+        }                                               \
+        return total;                                   \
+    }
+
+DEFINE_TOTAL_KERNEL(3)
+DEFINE_TOTAL_KERNEL(4)
+DEFINE_TOTAL_KERNEL(5)
+DEFINE_TOTAL_KERNEL(6)
+DEFINE_TOTAL_KERNEL(8)
+
+// Function to calculate total marks
+float calculateTotal(float marks[]) {
+    switch (subjectCount) {
+        case 3: return calculateTotal3(marks);
+        case 4: return calculateTotal4(marks);
+        case 5: return calculateTotal5(marks);
+        case 6: return calculateTotal6(marks);
+        case 8: return calculateTotal8(marks);
+    }
+
+    float total = 0;
+    for (int i = 0; i < subjectCount; i++) {
+        total += marks[i];
+    }
+    return total;
+}
+#endif
 
 //  calculate average marks
 float calculateAverage(float totalMarks) {
-    return totalMarks / 3.0;
+    return totalMarks / (double)subjectCount;
 }
 
 // assign grades based on average
 char getGrade(float averageMarks) {
-    if (averageMarks >= 85) return 'A';
-    else if (averageMarks >= 70) return 'B';
-    else if (averageMarks >= 50) return 'C';
-    else if (averageMarks >= 35) return 'D';
-    else return 'F';
+    for (int level = 0; level < GRADE_LEVELS - 1; level++) {
+        if (averageMarks >= gradeScheme.cutoffs[level]) return gradeLetters[level];
+    }
+    return gradeLetters[GRADE_LEVELS - 1];
+}
+
+int gradeIndex(char grade) {
+    return (int)(strchr(gradeLetters, grade) - gradeLetters);
+}
+
+#if SUBJECT_COUNT == 0
+// parse --grades "A,B,C,D" cut-offs; they must be descending within 0-100
+bool parseGradeScheme(const char *text, GradeScheme *scheme) {
+    GradeScheme parsed;
+    int consumed = 0;
+    if (sscanf(text, "%f,%f,%f,%f%n", &parsed.cutoffs[0], &parsed.cutoffs[1],
+               &parsed.cutoffs[2], &parsed.cutoffs[3], &consumed) != 4 || text[consumed] != '\0') {
+        return false;
+    }
+
+    for (int level = 0; level < GRADE_LEVELS - 1; level++) {
+        if (parsed.cutoffs[level] < 0 || parsed.cutoffs[level] > 100) return false;
+        if (level > 0 && parsed.cutoffs[level] >= parsed.cutoffs[level - 1]) return false;
+    }
+    *scheme = parsed;
+    return true;
+}
+#endif
+
+// fill in total, average and grade from the marks
+void gradeStudent(struct Student *student) {
+    student->totalMarks = calculateTotal(student->marks);
+    student->averageMarks = calculateAverage(student->totalMarks);
+    student->grade = getGrade(student->averageMarks);
+}
+
+// Buffered report output: rows are rendered into one large buffer and
+// written out with a single fwrite whenever it fills up.
+#define REPORT_BUFFER_SIZE (1 << 16)
+
+typedef enum { REPORT_TEXT, REPORT_CSV, REPORT_JSONL } ReportFormat;
+
+typedef struct {
+    FILE *output;
+    ReportFormat format;
+    size_t length;
+    char buffer[REPORT_BUFFER_SIZE];
+} ReportWriter;
+
+void flushReport(ReportWriter *writer) {
+    if (writer->length > 0) {
+        fwrite(writer->buffer, 1, writer->length, writer->output);
+        writer->length = 0;
+    }
+}
+
+// make room for at least size more bytes
+void reserveReport(ReportWriter *writer, size_t size) {
+    if (writer->length + size > REPORT_BUFFER_SIZE) flushReport(writer);
+}
+
+void appendChar(ReportWriter *writer, char c) {
+    reserveReport(writer, 1);
+    writer->buffer[writer->length++] = c;
+}
+
+void appendString(ReportWriter *writer, const char *text) {
+    for (; *text; text++) appendChar(writer, *text);
+}
+
+void appendInt(ReportWriter *writer, long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    reserveReport(writer, count + 1);
+    if (value < 0) writer->buffer[writer->length++] = '-';
+    while (count > 0) writer->buffer[writer->length++] = digits[--count];
+}
+
+// same digits as printf("%.2f") for float inputs: value * 100 is exact in
+// double and rint() breaks ties to even like glibc does
+void appendFixed2(ReportWriter *writer, float value) {
+    long long hundredths = (long long)rint((double)value * 100.0);
+    if (hundredths < 0) {
+        appendChar(writer, '-');
+        hundredths = -hundredths;
+    }
+    appendInt(writer, hundredths / 100);
+    reserveReport(writer, 3);
+    writer->buffer[writer->length++] = '.';
+    writer->buffer[writer->length++] = (char)('0' + hundredths / 10 % 10);
+    writer->buffer[writer->length++] = (char)('0' + hundredths % 10);
 }
 
 // display performance stars based on grade
-void showPerformance(char grade) {
-    int starCount = 0;
+void showPerformance(ReportWriter *writer, char grade) {
+    // A earns five stars, each lower grade one fewer; F gets none
+    int starCount = GRADE_LEVELS - gradeIndex(grade);
+    if (grade == gradeLetters[GRADE_LEVELS - 1]) return;
+
+    reserveReport(writer, starCount + 1);
+    memset(writer->buffer + writer->length, '*', starCount);
+    writer->length += starCount;
+    writer->buffer[writer->length++] = '\n';
+}
+
+void writeReportHeader(ReportWriter *writer) {
+    if (writer->format == REPORT_CSV) {
+        appendString(writer, "roll,name");
+        for (int j = 0; j < subjectCount; j++) {
+            appendString(writer, ",marks");
+            appendInt(writer, j + 1);
+        }
+        appendString(writer, ",total,average,grade\n");
+    }
+}
 
-    switch (grade) {
-        case 'A': starCount = 5; break;
-        case 'B': starCount = 4; break;
-        case 'C': starCount = 3; break;
-        case 'D': starCount = 2; break;
-        default: return;
+void writeStudentText(ReportWriter *writer, const struct Student *student) {
+    appendString(writer, "Roll: ");
+    appendInt(writer, student->rollNumber);
+    appendString(writer, "\nName: ");
+    appendString(writer, student->studentName);
+    appendString(writer, "\nTotal: ");
+    appendFixed2(writer, student->totalMarks);
+    appendString(writer, "\nAverage: ");
+    appendFixed2(writer, student->averageMarks);
+    appendString(writer, "\nGrade: ");
+    appendChar(writer, student->grade);
+    appendChar(writer, '\n');
+
+    if (student->grade != gradeLetters[GRADE_LEVELS - 1]) {
+        appendString(writer, "Performance: ");
+        showPerformance(writer, student->grade);
     }
+    appendString(writer, "\n\n");
+}
 
-    for (int i = 0; i < starCount; i++) {
-        printf("*");
+void writeStudentCsv(ReportWriter *writer, const struct Student *student) {
+    appendInt(writer, student->rollNumber);
+    appendString(writer, ",\"");
+    for (const char *c = student->studentName; *c; c++) {
+        if (*c == '"') appendChar(writer, '"');
+        appendChar(writer, *c);
+    }
+    appendChar(writer, '"');
+    for (int j = 0; j < subjectCount; j++) {
+        appendChar(writer, ',');
+        appendFixed2(writer, student->marks[j]);
+    }
+    appendChar(writer, ',');
+    appendFixed2(writer, student->totalMarks);
+    appendChar(writer, ',');
+    appendFixed2(writer, student->averageMarks);
+    appendChar(writer, ',');
+    appendChar(writer, student->grade);
+    appendChar(writer, '\n');
+}
+
+void writeStudentJson(ReportWriter *writer, const struct Student *student) {
+    appendString(writer, "{\"roll\":");
+    appendInt(writer, student->rollNumber);
+    appendString(writer, ",\"name\":\"");
+    for (const char *c = student->studentName; *c; c++) {
+        if (*c == '"' || *c == '\\') appendChar(writer, '\\');
+        appendChar(writer, *c);
+    }
+    appendString(writer, "\",\"marks\":[");
+    for (int j = 0; j < subjectCount; j++) {
+        if (j > 0) appendChar(writer, ',');
+        appendFixed2(writer, student->marks[j]);
+    }
+    appendString(writer, "],\"total\":");
+    appendFixed2(writer, student->totalMarks);
+    appendString(writer, ",\"average\":");
+    appendFixed2(writer, student->averageMarks);
+    appendString(writer, ",\"grade\":\"");
+    appendChar(writer, student->grade);
+    appendString(writer, "\"}\n");
+}
+
+void writeStudentReport(ReportWriter *writer, const struct Student *student) {
+    switch (writer->format) {
+        case REPORT_TEXT: writeStudentText(writer, student); break;
+        case REPORT_CSV: writeStudentCsv(writer, student); break;
+        case REPORT_JSONL: writeStudentJson(writer, student); break;
+    }
+}
+
+bool parseReportFormat(const char *name, ReportFormat *format) {
+    if (strcmp(name, "text") == 0) *format = REPORT_TEXT;
+    else if (strcmp(name, "csv") == 0) *format = REPORT_CSV;
+    else if (strcmp(name, "jsonl") == 0) *format = REPORT_JSONL;
+    else return false;
+    return true;
+}
+
+// write the report for the whole roll-sorted cohort
+int writeCohortReport(const struct Student students[], int totalStudents, ReportFormat format, FILE *output) {
+    ReportWriter *writer = (ReportWriter *)malloc(sizeof(ReportWriter));
+    if (writer == NULL) {
+        printf("Memory allocation failed for report buffer!\n");
+        return 1;
+    }
+    writer->output = output;
+    writer->format = format;
+    writer->length = 0;
+
+    writeReportHeader(writer);
+    for (int i = 0; i < totalStudents; i++) {
+        writeStudentReport(writer, &students[i]);
+    }
+    flushReport(writer);
+    fflush(output);
+
+    free(writer);
+    return 0;
+}
+
+int compareByRoll(const void *a, const void *b) {
+    int rollA = ((const struct Student *)a)->rollNumber;
+    int rollB = ((const struct Student *)b)->rollNumber;
+    return (rollA > rollB) - (rollA < rollB);
+}
+
+void sortStudentsByRoll(struct Student students[], int totalStudents) {
+    qsort(students, totalStudents, sizeof(struct Student), compareByRoll);
+}
+
+// Running mean and variance (Welford's method)
+typedef struct {
+    long long count;
+    double mean;
+    double m2;
+} RunningStats;
+
+// Fixed-size histogram of averageMarks used for percentiles
+typedef struct {
+    long long total;
+    long long counts[SCORE_BUCKETS];
+} ScoreSketch;
+
+void updateRunningStats(RunningStats *stats, double value) {
+    stats->count++;
+    double delta = value - stats->mean;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (value - stats->mean);
+}
+
+// inverse of updateRunningStats for a value that was added earlier
+void removeRunningStats(RunningStats *stats, double value) {
+    if (stats->count <= 1) {
+        *stats = (RunningStats){0};
+        return;
+    }
+    double delta = value - stats->mean;
+    stats->count--;
+    stats->mean -= delta / stats->count;
+    stats->m2 -= delta * (value - stats->mean);
+    if (stats->m2 < 0) stats->m2 = 0; // rounding after many add/remove pairs
+}
+
+double runningVariance(const RunningStats *stats) {
+    return stats->count > 0 && stats->m2 > 0 ? stats->m2 / stats->count : 0.0;
+}
+
+// map a score in [0, 100] to its 0.01-wide bucket
+int scoreToBucket(float score) {
+    int bucket = (int)(score * 100.0f + 0.5f);
+    if (bucket < 0) return 0;
+    if (bucket >= SCORE_BUCKETS) return SCORE_BUCKETS - 1;
+    return bucket;
+}
+
+void addToSketch(ScoreSketch *sketch, float score) {
+    sketch->counts[scoreToBucket(score)]++;
+    sketch->total++;
+}
+
+// nearest-rank percentile, exact to the 0.01 bucket width
+float sketchPercentile(const ScoreSketch *sketch, double percentile) {
+    if (sketch->total == 0) return 0.0f;
+
+    long long rank = (long long)(percentile / 100.0 * sketch->total + 0.999999);
+    if (rank < 1) rank = 1;
+
+    long long seen = 0;
+    for (int bucket = 0; bucket < SCORE_BUCKETS; bucket++) {
+        seen += sketch->counts[bucket];
+        if (seen >= rank) return bucket / 100.0f;
+    }
+    return 100.0f;
+}
+
+// parse "RollNo Name Marks1 ... MarksN" and grade the student
+bool parseStudentLine(const char *line, struct Student *student) {
+    int consumed = 0;
+    if (sscanf(line, "%d %49[a-zA-Z ]%n", &student->rollNumber, student->studentName, &consumed) != 2) {
+        return false;
+    }
+
+    const char *cursor = line + consumed;
+    for (int j = 0; j < subjectCount; j++) {
+        char *end;
+        student->marks[j] = strtof(cursor, &end);
+        if (end == cursor) return false;
+        cursor = end;
+    }
+    if (cursor[strspn(cursor, " \t\r\n")] != '\0') return false;
+
+    // drop the space the name pattern swallows before the marks
+    size_t nameLength = strlen(student->studentName);
+    while (nameLength > 0 && student->studentName[nameLength - 1] == ' ') {
+        student->studentName[--nameLength] = '\0';
+    }
+
+    for (int j = 0; j < subjectCount; j++) {
+        if (student->marks[j] < 0 || student->marks[j] > 100) return false;
+    }
+
+    gradeStudent(student);
+    return true;
+}
+
+// Single pass over a cohort file; memory use does not depend on cohort size
+int runStreamingStats(FILE *input) {
+    ScoreSketch *sketch = (ScoreSketch *)calloc(1, sizeof(ScoreSketch));
+    if (sketch == NULL) {
+        printf("Memory allocation failed for score sketch!\n");
+        return 1;
+    }
+
+    RunningStats subjectStats[STUDENT_MARKS] = {{0}};
+    RunningStats averageStats = {0};
+    long long gradeCounts[GRADE_LEVELS] = {0};
+    long long rejectedLines = 0, lineNumber = 0;
+    char line[MAX_LINE_LENGTH];
+    struct Student student;
+
+    while (fgets(line, sizeof(line), input) != NULL) {
+        lineNumber++;
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        if (!parseStudentLine(line, &student)) {
+            fprintf(stderr, "Skipping invalid line %lld\n", lineNumber);
+            rejectedLines++;
+            continue;
+        }
+
+        for (int j = 0; j < subjectCount; j++) {
+            updateRunningStats(&subjectStats[j], student.marks[j]);
+        }
+        updateRunningStats(&averageStats, student.averageMarks);
+        addToSketch(sketch, student.averageMarks);
+        gradeCounts[gradeIndex(student.grade)]++;
+    }
+
+    printf("Students processed: %lld (rejected lines: %lld)\n", averageStats.count, rejectedLines);
+    if (averageStats.count == 0) {
+        free(sketch);
+        return 0;
+    }
+
+    for (int j = 0; j < subjectCount; j++) {
+        printf("Subject %d: mean %.2f, variance %.2f\n",
+               j + 1, subjectStats[j].mean, runningVariance(&subjectStats[j]));
+    }
+    printf("Average: mean %.2f, variance %.2f\n", averageStats.mean, runningVariance(&averageStats));
+
+    const double percentiles[] = {10, 25, 50, 75, 90, 99};
+    printf("Percentiles of average:");
+    for (int p = 0; p < 6; p++) {
+        printf(" P%.0f=%.2f", percentiles[p], sketchPercentile(sketch, percentiles[p]));
+    }
+    printf("\n");
+
+    printf("Grades:");
+    for (int g = 0; g < GRADE_LEVELS; g++) {
+        printf(" %c=%lld", gradeLetters[g], gradeCounts[g]);
     }
     printf("\n");
+
+    free(sketch);
+    return 0;
+}
+
+// read a whole cohort file into a growing array; invalid lines are skipped
+int loadCohort(FILE *input, struct Student **students, int *totalStudents) {
+    int capacity = 1024, count = 0;
+    long long lineNumber = 0;
+    char line[MAX_LINE_LENGTH];
+    struct Student *cohort = (struct Student *)malloc(capacity * sizeof(struct Student));
+    if (cohort == NULL) {
+        printf("Memory allocation failed for cohort!\n");
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), input) != NULL) {
+        lineNumber++;
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        if (count == capacity) {
+            struct Student *grown = (struct Student *)realloc(cohort, 2 * (size_t)capacity * sizeof(struct Student));
+            if (grown == NULL) {
+                printf("Memory allocation failed while growing cohort!\n");
+                free(cohort);
+                return 1;
+            }
+            cohort = grown;
+            capacity *= 2;
+        }
+
+        if (!parseStudentLine(line, &cohort[count])) {
+            fprintf(stderr, "Skipping invalid line %lld\n", lineNumber);
+            continue;
+        }
+        count++;
+    }
+
+    *students = cohort;
+    *totalStudents = count;
+    return 0;
+}
+
+// Batch mode: load, sort by roll and write the report in the chosen format
+int runBatchReport(FILE *input, ReportFormat format) {
+    struct Student *students;
+    int totalStudents;
+    if (loadCohort(input, &students, &totalStudents) != 0) return 1;
+
+    sortStudentsByRoll(students, totalStudents);
+    int status = writeCohortReport(students, totalStudents, format, stdout);
+
+    free(students);
+    return status;
+}
+
+// Order-statistic index over averageMarks: a Fenwick tree of bucket counts
+// plus a list of students per bucket. Students in the same 0.01 bucket tie.
+typedef struct {
+    int studentCount;
+    int *tree;
+    int *bucketHead;
+    int *nextInBucket;
+    int *prevInBucket;
+    int *studentBucket;
+} RankIndex;
+
+void fenwickAdd(int *tree, int bucket, int delta) {
+    for (int i = bucket + 1; i <= SCORE_BUCKETS; i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+// number of students in buckets 0..bucket
+int fenwickPrefix(const int *tree, int bucket) {
+    int sum = 0;
+    for (int i = bucket + 1; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+// smallest bucket whose prefix count reaches target (target >= 1)
+int fenwickLowerBound(const int *tree, int target) {
+    int position = 0, step = 1;
+    while (step * 2 <= SCORE_BUCKETS) step *= 2;
+
+    for (; step > 0; step /= 2) {
+        if (position + step <= SCORE_BUCKETS && tree[position + step] < target) {
+            position += step;
+            target -= tree[position];
+        }
+    }
+    return position;
+}
+
+void linkIntoBucket(RankIndex *index, int studentIndex, int bucket) {
+    index->studentBucket[studentIndex] = bucket;
+    index->prevInBucket[studentIndex] = -1;
+    index->nextInBucket[studentIndex] = index->bucketHead[bucket];
+    if (index->bucketHead[bucket] != -1) index->prevInBucket[index->bucketHead[bucket]] = studentIndex;
+    index->bucketHead[bucket] = studentIndex;
+    fenwickAdd(index->tree, bucket, 1);
+}
+
+void unlinkFromBucket(RankIndex *index, int studentIndex) {
+    int bucket = index->studentBucket[studentIndex];
+    int prev = index->prevInBucket[studentIndex];
+    int next = index->nextInBucket[studentIndex];
+
+    if (prev != -1) index->nextInBucket[prev] = next;
+    else index->bucketHead[bucket] = next;
+    if (next != -1) index->prevInBucket[next] = prev;
+    fenwickAdd(index->tree, bucket, -1);
+}
+
+void freeRankIndex(RankIndex *index) {
+    free(index->tree);
+    free(index->bucketHead);
+    free(index->nextInBucket);
+    free(index->prevInBucket);
+    free(index->studentBucket);
+}
+
+bool buildRankIndex(RankIndex *index, struct Student students[], int totalStudents) {
+    index->studentCount = totalStudents;
+    index->tree = (int *)calloc(SCORE_BUCKETS + 1, sizeof(int));
+    index->bucketHead = (int *)malloc(SCORE_BUCKETS * sizeof(int));
+    index->nextInBucket = (int *)malloc(totalStudents * sizeof(int));
+    index->prevInBucket = (int *)malloc(totalStudents * sizeof(int));
+    index->studentBucket = (int *)malloc(totalStudents * sizeof(int));
+
+    if (index->tree == NULL || index->bucketHead == NULL || index->nextInBucket == NULL ||
+        index->prevInBucket == NULL || index->studentBucket == NULL) {
+        printf("Memory allocation failed for rank index!\n");
+        freeRankIndex(index);
+        return false;
+    }
+
+    for (int bucket = 0; bucket < SCORE_BUCKETS; bucket++) {
+        index->bucketHead[bucket] = -1;
+    }
+    for (int i = totalStudents - 1; i >= 0; i--) {
+        linkIntoBucket(index, i, scoreToBucket(students[i].averageMarks));
+    }
+    return true;
+}
+
+// move a student to the bucket of its new average without re-sorting
+void updateRankIndex(RankIndex *index, int studentIndex, float newAverage) {
+    int bucket = scoreToBucket(newAverage);
+    if (bucket == index->studentBucket[studentIndex]) return;
+    unlinkFromBucket(index, studentIndex);
+    linkIntoBucket(index, studentIndex, bucket);
+}
+
+// 1-based rank by average, highest first; tied students share a rank
+int rankOfStudent(const RankIndex *index, int studentIndex) {
+    int bucket = index->studentBucket[studentIndex];
+    return index->studentCount - fenwickPrefix(index->tree, bucket) + 1;
+}
+
+// index of the k-th best student (1-based), or -1 if out of range
+int kthBestStudent(const RankIndex *index, int k) {
+    if (k < 1 || k > index->studentCount) return -1;
+
+    int bucket = fenwickLowerBound(index->tree, index->studentCount - k + 1);
+    int above = index->studentCount - fenwickPrefix(index->tree, bucket);
+    int studentIndex = index->bucketHead[bucket];
+    for (int skip = k - above - 1; skip > 0; skip--) {
+        studentIndex = index->nextInBucket[studentIndex];
+    }
+    return studentIndex;
+}
+
+// fill result with up to k student indices, best first; returns the count
+int topStudents(const RankIndex *index, int k, int result[]) {
+    int found = 0;
+    int below = index->studentCount;
+
+    while (found < k && below > 0) {
+        int bucket = fenwickLowerBound(index->tree, below);
+        for (int i = index->bucketHead[bucket]; i != -1 && found < k; i = index->nextInBucket[i]) {
+            result[found++] = i;
+        }
+        below = bucket > 0 ? fenwickPrefix(index->tree, bucket - 1) : 0;
+    }
+    return found;
+}
+
+// binary search in the roll-sorted array
+int findStudentByRoll(struct Student students[], int totalStudents, int rollNumber) {
+    int low = 0, high = totalStudents - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (students[mid].rollNumber == rollNumber) return mid;
+        if (students[mid].rollNumber < rollNumber) low = mid + 1;
+        else high = mid - 1;
+    }
+    return -1;
+}
+
+// rank/top-K queries after the results are printed
+void runRankQueries(struct Student students[], int totalStudents) {
+    RankIndex index;
+    if (!buildRankIndex(&index, students, totalStudents)) return;
+
+    int *topList = (int *)malloc(totalStudents * sizeof(int));
+    if (topList == NULL) {
+        printf("Memory allocation failed for query buffer!\n");
+        freeRankIndex(&index);
+        return;
+    }
+
+    char command[20];
+    printf("\nQueries: rank <roll> | kth <k> | top <k> | correct <roll> <subject> <mark> | exit\n");
+
+    while (1) {
+        printf("Query> ");
+        if (scanf("%19s", command) != 1 || strcmp(command, "exit") == 0) break;
+
+        if (strcmp(command, "rank") == 0) {
+            int rollNumber;
+            if (scanf("%d", &rollNumber) != 1) break;
+            int i = findStudentByRoll(students, totalStudents, rollNumber);
+            if (i == -1) printf("Roll %d not found\n", rollNumber);
+            else printf("Roll %d is ranked %d of %d (average %.2f)\n",
+                        rollNumber, rankOfStudent(&index, i), totalStudents, students[i].averageMarks);
+        }
+        else if (strcmp(command, "kth") == 0) {
+            int k;
+            if (scanf("%d", &k) != 1) break;
+            int i = kthBestStudent(&index, k);
+            if (i == -1) printf("k must be between 1 and %d\n", totalStudents);
+            else printf("#%d: Roll %d %s (average %.2f)\n",
+                        k, students[i].rollNumber, students[i].studentName, students[i].averageMarks);
+        }
+        else if (strcmp(command, "top") == 0) {
+            int k;
+            if (scanf("%d", &k) != 1) break;
+            int found = topStudents(&index, k, topList);
+            for (int position = 0; position < found; position++) {
+                int i = topList[position];
+                printf("#%d: Roll %d %s (average %.2f)\n", position + 1,
+                       students[i].rollNumber, students[i].studentName, students[i].averageMarks);
+            }
+        }
+        else if (strcmp(command, "correct") == 0) {
+            int rollNumber, subject;
+            float mark;
+            if (scanf("%d %d %f", &rollNumber, &subject, &mark) != 3) break;
+            int i = findStudentByRoll(students, totalStudents, rollNumber);
+            if (i == -1) printf("Roll %d not found\n", rollNumber);
+            else if (subject < 1 || subject > subjectCount || mark < 0 || mark > 100) printf("Invalid subject or mark\n");
+            else {
+                students[i].marks[subject - 1] = mark;
+                gradeStudent(&students[i]);
+                updateRankIndex(&index, i, students[i].averageMarks);
+                printf("Roll %d: average %.2f, grade %c, rank %d\n", rollNumber,
+                       students[i].averageMarks, students[i].grade, rankOfStudent(&index, i));
+            }
+        }
+        else {
+            printf("Invalid query\n");
+        }
+    }
+
+    free(topList);
+    freeRankIndex(&index);
+}
+
+// Binary cohort snapshot, laid out as:
+//   SnapshotHeader
+//   struct Student students[studentCount]     (sorted by roll number)
+//   int rankOrder[studentCount]               (student indices, best average first)
+//   int studentsAbove[SCORE_BUCKETS]          (students in strictly higher buckets)
+// The checksum covers everything after the header. Opening a snapshot only
+// checks the header and file size so queries stay O(answer); the checksum is
+// verified by --verify and before --apply rewrites the cohort. The file uses
+// the native struct layout and byte order, so it is only read back by the
+// same build on the same kind of machine.
+#define SNAPSHOT_MAGIC 0x31415053u   // "SPA1"
+#define SNAPSHOT_VERSION 1
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int recordSize;
+    int subjectCount;
+    GradeScheme gradeScheme;
+    int studentCount;
+    unsigned long long checksum;
+} SnapshotHeader;
+
+typedef struct {
+    void *mapping;
+    size_t mappingSize;
+    const SnapshotHeader *header;
+    const struct Student *students;
+    const int *rankOrder;
+    const int *studentsAbove;
+} CohortSnapshot;
+
+// FNV-1a over 8-byte words, then the remaining tail bytes
+unsigned long long snapshotChecksum(const void *data, size_t size, unsigned long long hash) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    size_t offset = 0;
+
+    for (; offset + 8 <= size; offset += 8) {
+        unsigned long long word;
+        memcpy(&word, bytes + offset, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+    for (; offset < size; offset++) {
+        hash = (hash ^ bytes[offset]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+size_t snapshotSize(int studentCount) {
+    return sizeof(SnapshotHeader) + (size_t)studentCount * (sizeof(struct Student) + sizeof(int)) +
+           SCORE_BUCKETS * sizeof(int);
+}
+
+// write the roll-sorted cohort with its rank order and bucket ranks
+int writeSnapshot(const char *path, struct Student students[], int totalStudents) {
+    RankIndex index;
+    if (!buildRankIndex(&index, students, totalStudents)) return 1;
+
+    size_t bodySize = snapshotSize(totalStudents) - sizeof(SnapshotHeader);
+    unsigned char *body = (unsigned char *)calloc(1, bodySize);
+    if (body == NULL) {
+        printf("Memory allocation failed for snapshot!\n");
+        freeRankIndex(&index);
+        return 1;
+    }
+
+    // copy field by field so padding and unused marks are written as zeros
+    struct Student *records = (struct Student *)body;
+    for (int i = 0; i < totalStudents; i++) {
+        records[i].rollNumber = students[i].rollNumber;
+        memcpy(records[i].studentName, students[i].studentName, strlen(students[i].studentName) + 1);
+        memcpy(records[i].marks, students[i].marks, subjectCount * sizeof(float));
+        records[i].totalMarks = students[i].totalMarks;
+        records[i].averageMarks = students[i].averageMarks;
+        records[i].grade = students[i].grade;
+    }
+
+    int *rankOrder = (int *)(records + totalStudents);
+    topStudents(&index, totalStudents, rankOrder);
+
+    int *studentsAbove = rankOrder + totalStudents;
+    for (int bucket = 0; bucket < SCORE_BUCKETS; bucket++) {
+        studentsAbove[bucket] = totalStudents - fenwickPrefix(index.tree, bucket);
+    }
+    freeRankIndex(&index);
+
+    SnapshotHeader header = {0};
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.recordSize = sizeof(struct Student);
+    header.subjectCount = subjectCount;
+    header.gradeScheme = gradeScheme;
+    header.studentCount = totalStudents;
+    header.checksum = snapshotChecksum(body, bodySize, 0xcbf29ce484222325ULL);
+
+    FILE *output = fopen(path, "wb");
+    if (output == NULL) {
+        printf("Could not create %s\n", path);
+        free(body);
+        return 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(body, 1, bodySize, output) == bodySize;
+    if (fclose(output) != 0) written = false;
+    free(body);
+
+    if (!written) {
+        printf("Failed to write %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+void closeSnapshot(CohortSnapshot *snapshot) {
+    if (snapshot->mapping != NULL) munmap(snapshot->mapping, snapshot->mappingSize);
+    snapshot->mapping = NULL;
+}
+
+// map a snapshot read-only and validate its header and size, plus the body
+// checksum when verifyChecksum is set
+bool openSnapshot(const char *path, CohortSnapshot *snapshot, bool verifyChecksum) {
+    snapshot->mapping = NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || (size_t)fileInfo.st_size < sizeof(SnapshotHeader)) {
+        printf("%s is not a cohort snapshot\n", path);
+        close(fd);
+        return false;
+    }
+
+    snapshot->mappingSize = (size_t)fileInfo.st_size;
+    void *mapping = mmap(NULL, snapshot->mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("Could not map %s\n", path);
+        return false;
+    }
+    snapshot->mapping = mapping;
+
+    const SnapshotHeader *header = (const SnapshotHeader *)mapping;
+    if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+        header->recordSize != sizeof(struct Student) ||
+        header->subjectCount < 1 || header->subjectCount > STUDENT_MARKS ||
+        header->studentCount < 0 || snapshotSize(header->studentCount) != snapshot->mappingSize) {
+        printf("%s is not a compatible cohort snapshot\n", path);
+        closeSnapshot(snapshot);
+        return false;
+    }
+
+    const unsigned char *body = (const unsigned char *)mapping + sizeof(SnapshotHeader);
+    if (verifyChecksum &&
+        snapshotChecksum(body, snapshot->mappingSize - sizeof(SnapshotHeader), 0xcbf29ce484222325ULL) != header->checksum) {
+        printf("%s is corrupted (checksum mismatch)\n", path);
+        closeSnapshot(snapshot);
+        return false;
+    }
+
+    snapshot->header = header;
+    snapshot->students = (const struct Student *)body;
+    snapshot->rankOrder = (const int *)(snapshot->students + header->studentCount);
+    snapshot->studentsAbove = snapshot->rankOrder + header->studentCount;
+
+#if SUBJECT_COUNT > 0
+    if (header->subjectCount != SUBJECT_COUNT ||
+        memcmp(&header->gradeScheme, &gradeScheme, sizeof(GradeScheme)) != 0) {
+        printf("%s was saved with a different subject count or grading scheme\n", path);
+        closeSnapshot(snapshot);
+        return false;
+    }
+#else
+    // reports and grading follow the configuration the snapshot was built with
+    subjectCount = header->subjectCount;
+    gradeScheme = header->gradeScheme;
+#endif
+    return true;
+}
+
+int findSnapshotStudent(const CohortSnapshot *snapshot, int rollNumber) {
+    int low = 0, high = snapshot->header->studentCount - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        if (snapshot->students[mid].rollNumber == rollNumber) return mid;
+        if (snapshot->students[mid].rollNumber < rollNumber) low = mid + 1;
+        else high = mid - 1;
+    }
+    return -1;
+}
+
+void printRankedStudent(const struct Student *student, int position) {
+    printf("#%d: Roll %d %s (average %.2f)\n", position, student->rollNumber,
+           student->studentName, student->averageMarks);
+}
+
+// answer one query straight from the mapped snapshot:
+//   report [text|csv|jsonl] | rank <roll> | kth <k> | top <k>
+int runSnapshotQuery(const CohortSnapshot *snapshot, int argc, char *argv[]) {
+    int studentCount = snapshot->header->studentCount;
+    const char *query = argc >= 1 ? argv[0] : "report";
+
+    if (strcmp(query, "report") == 0) {
+        ReportFormat format = REPORT_TEXT;
+        if (argc >= 2 && !parseReportFormat(argv[1], &format)) {
+            printf("Unknown report format %s (use text, csv or jsonl)\n", argv[1]);
+            return 1;
+        }
+        return writeCohortReport(snapshot->students, studentCount, format, stdout);
+    }
+    if (argc < 2) {
+        printf("Missing argument for %s\n", query);
+        return 1;
+    }
+
+    int value = atoi(argv[1]);
+    if (strcmp(query, "rank") == 0) {
+        int i = findSnapshotStudent(snapshot, value);
+        if (i == -1) {
+            printf("Roll %d not found\n", value);
+            return 1;
+        }
+        const struct Student *student = &snapshot->students[i];
+        printf("Roll %d is ranked %d of %d (average %.2f)\n", value,
+               snapshot->studentsAbove[scoreToBucket(student->averageMarks)] + 1,
+               studentCount, student->averageMarks);
+    }
+    else if (strcmp(query, "kth") == 0) {
+        if (value < 1 || value > studentCount) {
+            printf("k must be between 1 and %d\n", studentCount);
+            return 1;
+        }
+        int i = snapshot->rankOrder[value - 1];
+        if (i < 0 || i >= studentCount) {
+            printf("Snapshot rank order is corrupted (run --verify)\n");
+            return 1;
+        }
+        printRankedStudent(&snapshot->students[i], value);
+    }
+    else if (strcmp(query, "top") == 0) {
+        for (int position = 0; position < value && position < studentCount; position++) {
+            int i = snapshot->rankOrder[position];
+            if (i < 0 || i >= studentCount) {
+                printf("Snapshot rank order is corrupted (run --verify)\n");
+                return 1;
+            }
+            printRankedStudent(&snapshot->students[i], position + 1);
+        }
+    }
+    else {
+        printf("Unknown snapshot query %s\n", query);
+        return 1;
+    }
+    return 0;
+}
+
+// stdin for "-", otherwise the named file
+FILE *openInputFile(const char *path) {
+    if (strcmp(path, "-") == 0) return stdin;
+
+    FILE *input = fopen(path, "r");
+    if (input == NULL) printf("Could not open %s\n", path);
+    return input;
+}
+
+void closeInputFile(FILE *input) {
+    if (input != stdin) fclose(input);
+}
+
+// Open-addressing hash index from roll number to array position
+typedef struct {
+    int capacity;       // power of two
+    int *rollNumbers;
+    int *positions;     // -1 marks an empty slot
+} RollIndex;
+
+unsigned int hashRoll(int rollNumber) {
+    return (unsigned int)rollNumber * 2654435761u;
+}
+
+void freeRollIndex(RollIndex *index) {
+    free(index->rollNumbers);
+    free(index->positions);
+}
+
+bool buildRollIndex(RollIndex *index, const struct Student students[], int totalStudents) {
+    index->capacity = 16;
+    while (index->capacity < 2 * totalStudents) index->capacity *= 2;
+    index->rollNumbers = (int *)malloc(index->capacity * sizeof(int));
+    index->positions = (int *)malloc(index->capacity * sizeof(int));
+    if (index->rollNumbers == NULL || index->positions == NULL) {
+        printf("Memory allocation failed for roll index!\n");
+        freeRollIndex(index);
+        return false;
+    }
+
+    for (int slot = 0; slot < index->capacity; slot++) index->positions[slot] = -1;
+    for (int i = 0; i < totalStudents; i++) {
+        unsigned int slot = hashRoll(students[i].rollNumber) & (index->capacity - 1);
+        while (index->positions[slot] != -1) slot = (slot + 1) & (index->capacity - 1);
+        index->rollNumbers[slot] = students[i].rollNumber;
+        index->positions[slot] = i;
+    }
+    return true;
+}
+
+int lookupRoll(const RollIndex *index, int rollNumber) {
+    unsigned int slot = hashRoll(rollNumber) & (index->capacity - 1);
+    while (index->positions[slot] != -1) {
+        if (index->rollNumbers[slot] == rollNumber) return index->positions[slot];
+        slot = (slot + 1) & (index->capacity - 1);
+    }
+    return -1;
+}
+
+// Cohort-level aggregates kept as running (Welford) stats so a student can be
+// taken out and put back in O(subjects) when its marks change
+typedef struct {
+    RunningStats subjects[STUDENT_MARKS];
+    RunningStats average;
+    long long gradeCounts[GRADE_LEVELS];
+} CohortStats;
+
+// sign is +1 to add the student, -1 to remove it
+void accumulateCohortStats(CohortStats *stats, const struct Student *student, int sign) {
+    void (*update)(RunningStats *, double) = sign > 0 ? updateRunningStats : removeRunningStats;
+    for (int j = 0; j < subjectCount; j++) {
+        update(&stats->subjects[j], student->marks[j]);
+    }
+    update(&stats->average, student->averageMarks);
+    stats->gradeCounts[gradeIndex(student->grade)] += sign;
+}
+
+void printCohortStats(const CohortStats *stats) {
+    if (stats->average.count == 0) return;
+
+    for (int j = 0; j < subjectCount; j++) {
+        printf("Subject %d: mean %.2f, variance %.2f\n", j + 1, stats->subjects[j].mean,
+               runningVariance(&stats->subjects[j]));
+    }
+    printf("Average: mean %.2f, variance %.2f\n", stats->average.mean, runningVariance(&stats->average));
+
+    printf("Grades:");
+    for (int g = 0; g < GRADE_LEVELS; g++) {
+        printf(" %c=%lld", gradeLetters[g], stats->gradeCounts[g]);
+    }
+    printf("\n");
+}
+
+// Apply "rollNumber subject newMark" corrections to a snapshot cohort,
+// re-grading only the students they touch
+int applyCorrections(const CohortSnapshot *snapshot, FILE *deltas, const char *outputPath) {
+    int totalStudents = snapshot->header->studentCount;
+    struct Student *students = (struct Student *)malloc((totalStudents > 0 ? totalStudents : 1) * sizeof(struct Student));
+    if (students == NULL) {
+        printf("Memory allocation failed for cohort!\n");
+        return 1;
+    }
+    memcpy(students, snapshot->students, totalStudents * sizeof(struct Student));
+
+    RollIndex rollIndex;
+    RankIndex rankIndex;
+    if (!buildRollIndex(&rollIndex, students, totalStudents)) {
+        free(students);
+        return 1;
+    }
+    if (!buildRankIndex(&rankIndex, students, totalStudents)) {
+        freeRollIndex(&rollIndex);
+        free(students);
+        return 1;
+    }
+
+    CohortStats stats = {0};
+    for (int i = 0; i < totalStudents; i++) {
+        accumulateCohortStats(&stats, &students[i], 1);
+    }
+
+    char line[MAX_LINE_LENGTH];
+    long long lineNumber = 0, applied = 0, rejected = 0;
+    while (fgets(line, sizeof(line), deltas) != NULL) {
+        lineNumber++;
+        if (line[strspn(line, " \t\r\n")] == '\0') continue;
+
+        int rollNumber, subject;
+        float mark;
+        char extraChar;
+        if (sscanf(line, "%d %d %f %c", &rollNumber, &subject, &mark, &extraChar) != 3 ||
+            subject < 1 || subject > subjectCount || mark < 0 || mark > 100) {
+            fprintf(stderr, "Skipping invalid correction on line %lld\n", lineNumber);
+            rejected++;
+            continue;
+        }
+
+        int i = lookupRoll(&rollIndex, rollNumber);
+        if (i == -1) {
+            fprintf(stderr, "Line %lld: roll %d not found\n", lineNumber, rollNumber);
+            rejected++;
+            continue;
+        }
+
+        struct Student *student = &students[i];
+        float oldAverage = student->averageMarks;
+        char oldGrade = student->grade;
+
+        accumulateCohortStats(&stats, student, -1);
+        student->marks[subject - 1] = mark;
+        gradeStudent(student);
+        accumulateCohortStats(&stats, student, 1);
+        updateRankIndex(&rankIndex, i, student->averageMarks);
+
+        printf("Roll %d: average %.2f -> %.2f, grade %c -> %c, rank %d\n", rollNumber,
+               oldAverage, student->averageMarks, oldGrade, student->grade, rankOfStudent(&rankIndex, i));
+        applied++;
+    }
+
+    printf("Applied %lld corrections (rejected: %lld)\n", applied, rejected);
+    printCohortStats(&stats);
+
+    int status = 0;
+    if (outputPath != NULL) {
+        status = writeSnapshot(outputPath, students, totalStudents);
+        if (status == 0) printf("Saved updated cohort to %s\n", outputPath);
+    }
+
+    freeRankIndex(&rankIndex);
+    freeRollIndex(&rollIndex);
+    free(students);
+    return status;
 }
 
 // Recursive function to print all roll numbers
@@ -60,7 +1207,122 @@ void printRollNumbers(struct Student students[], int index, int totalStudents) {
     printRollNumbers(students, index + 1, totalStudents);
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    // --subjects N and --grades A,B,C,D may precede any mode in the -DSUBJECT_COUNT=0 build
+    while (argc >= 3 && (strcmp(argv[1], "--subjects") == 0 || strcmp(argv[1], "--grades") == 0)) {
+#if SUBJECT_COUNT > 0
+        printf("This build grades %d subjects with fixed cut-offs; rebuild with -DSUBJECT_COUNT=0 to use %s.\n",
+               SUBJECT_COUNT, argv[1]);
+        return 1;
+#else
+        if (strcmp(argv[1], "--subjects") == 0) {
+            subjectCount = atoi(argv[2]);
+            if (subjectCount < 1 || subjectCount > MAX_SUBJECTS) {
+                printf("Number of subjects must be between 1 and %d.\n", MAX_SUBJECTS);
+                return 1;
+            }
+        }
+        else if (!parseGradeScheme(argv[2], &gradeScheme)) {
+            printf("Grade cut-offs must be four descending values between 0 and 100, e.g. 85,70,50,35\n");
+            return 1;
+        }
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+#endif
+    }
+
+    // streaming mode: analyzer --stream [file]
+    if (argc >= 2 && strcmp(argv[1], "--stream") == 0) {
+        if (argc < 3 || strcmp(argv[2], "-") == 0) return runStreamingStats(stdin);
+
+        FILE *input = fopen(argv[2], "r");
+        if (input == NULL) {
+            printf("Could not open %s\n", argv[2]);
+            return 1;
+        }
+        int status = runStreamingStats(input);
+        fclose(input);
+        return status;
+    }
+
+    // batch mode: analyzer --report <file> [text|csv|jsonl]
+    if (argc >= 3 && strcmp(argv[1], "--report") == 0) {
+        ReportFormat format = REPORT_TEXT;
+        if (argc >= 4 && !parseReportFormat(argv[3], &format)) {
+            printf("Unknown report format %s (use text, csv or jsonl)\n", argv[3]);
+            return 1;
+        }
+        if (strcmp(argv[2], "-") == 0) return runBatchReport(stdin, format);
+
+        FILE *input = fopen(argv[2], "r");
+        if (input == NULL) {
+            printf("Could not open %s\n", argv[2]);
+            return 1;
+        }
+        int status = runBatchReport(input, format);
+        fclose(input);
+        return status;
+    }
+
+    // snapshot build: analyzer --save <cohort file> <snapshot>
+    if (argc >= 4 && strcmp(argv[1], "--save") == 0) {
+        FILE *input = openInputFile(argv[2]);
+        if (input == NULL) return 1;
+
+        struct Student *students;
+        int studentCount;
+        int status = loadCohort(input, &students, &studentCount);
+        closeInputFile(input);
+        if (status != 0) return status;
+
+        sortStudentsByRoll(students, studentCount);
+        status = writeSnapshot(argv[3], students, studentCount);
+        if (status == 0) printf("Saved %d students to %s\n", studentCount, argv[3]);
+        free(students);
+        return status;
+    }
+
+    // corrections: analyzer --apply <snapshot> <delta file> [updated snapshot]
+    if (argc >= 4 && strcmp(argv[1], "--apply") == 0) {
+        CohortSnapshot snapshot;
+        if (!openSnapshot(argv[2], &snapshot, true)) return 1;
+
+        FILE *deltas = openInputFile(argv[3]);
+        if (deltas == NULL) {
+            closeSnapshot(&snapshot);
+            return 1;
+        }
+
+        int status = applyCorrections(&snapshot, deltas, argc >= 5 ? argv[4] : NULL);
+        closeInputFile(deltas);
+        closeSnapshot(&snapshot);
+        return status;
+    }
+
+    // full integrity check: analyzer --verify <snapshot>
+    if (argc >= 3 && strcmp(argv[1], "--verify") == 0) {
+        CohortSnapshot snapshot;
+        if (!openSnapshot(argv[2], &snapshot, true)) return 1;
+
+        printf("%s: %d students, checksum OK\n", argv[2], snapshot.header->studentCount);
+        closeSnapshot(&snapshot);
+        return 0;
+    }
+
+    // snapshot queries: analyzer --load <snapshot> [report [format] | rank <roll> | kth <k> | top <k>]
+    if (argc >= 3 && strcmp(argv[1], "--load") == 0) {
+        CohortSnapshot snapshot;
+        if (!openSnapshot(argv[2], &snapshot, false)) return 1;
+
+        int status = runSnapshotQuery(&snapshot, argc - 3, argv + 3);
+        closeSnapshot(&snapshot);
+        return status;
+    }
+
+    // interactive entry, optionally followed by rank queries: analyzer [--query]
+    bool rankQueries = argc >= 2 && strcmp(argv[1], "--query") == 0;
+
     int totalStudents;
 
     printf("Enter the number of students: ");
@@ -76,16 +1338,14 @@ int main() {
     struct Student students[totalStudents];
 
     for (int i = 0; i < totalStudents; i++) {
-        printf("\nEnter details for student %d (RollNo Name Marks1 Marks2 Marks3): ", i + 1);
-        scanf("%d %[a-zA-Z ] %f %f %f",
-              &students[i].rollNumber,
-              students[i].studentName,
-              &students[i].marks[0],
-              &students[i].marks[1],
-              &students[i].marks[2]);
+        printf("\nEnter details for student %d (RollNo Name", i + 1);
+        for (int j = 0; j < subjectCount; j++) printf(" Marks%d", j + 1);
+        printf("): ");
+        scanf("%d %[a-zA-Z ]", &students[i].rollNumber, students[i].studentName);
+        for (int j = 0; j < subjectCount; j++) scanf("%f", &students[i].marks[j]);
 
         //marks>=0 and marks <=100
-       for(int j=0; j<3; j++){
+       for(int j=0; j<subjectCount; j++){
                 bool flag = true;
                 while(flag){
                 if(students[i].marks[j] <0 || students[i].marks[j] > 100) {
@@ -99,42 +1359,21 @@ int main() {
             }
           } 
         
-        students[i].totalMarks = calculateTotal(students[i].marks);
-        students[i].averageMarks = calculateAverage(students[i].totalMarks);
-        students[i].grade = getGrade(students[i].averageMarks);
-    }
-
-     // Sort students by roll number
-    for (int i = 0; i < totalStudents - 1; i++) {
-        for (int j = i + 1; j < totalStudents; j++) {
-            if (students[i].rollNumber > students[j].rollNumber) {
-                struct Student temporaryStudent = students[i];
-                students[i] = students[j];
-                students[j] = temporaryStudent;
-            }
-        }
+        gradeStudent(&students[i]);
     }
 
+    sortStudentsByRoll(students, totalStudents);
+
     printf("\n\n");
 
     // Display student results
-    for (int i = 0; i < totalStudents; i++) {
-        printf("Roll: %d\n", students[i].rollNumber);
-        printf("Name: %s\n", students[i].studentName);
-        printf("Total: %.2f\n", students[i].totalMarks);
-        printf("Average: %.2f\n", students[i].averageMarks);
-        printf("Grade: %c\n", students[i].grade);
-
-        if (students[i].averageMarks >= 35) {
-            printf("Performance: ");
-            showPerformance(students[i].grade);
-        }
-        printf("\n\n");
-    }
+    writeCohortReport(students, totalStudents, REPORT_TEXT, stdout);
 
     printf("List of Roll Numbers : ");
     printRollNumbers(students, 0, totalStudents);
     printf("\n");
 
+    if (rankQueries) runRankQueries(students, totalStudents);
+
     return 0;
 }
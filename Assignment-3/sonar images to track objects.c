@@ -1,173 +1,3430 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Generate a random N×N matrix with values 0–255
-void generateRandomMatrix(int **matrixData, int matrixSize) {
-  
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Pixel depth is chosen at build time: 8-bit by default, -DSONAR_PIXEL_BITS=16
+// for raw sonar intensities
+#ifndef SONAR_PIXEL_BITS
+#define SONAR_PIXEL_BITS 8
+#endif
+
+#if SONAR_PIXEL_BITS == 16
+typedef uint16_t Pixel;
+#define PIXEL_MAX 65535
+#define PIXEL_PRINT_WIDTH 6
+#elif SONAR_PIXEL_BITS == 8
+typedef uint8_t Pixel;
+#define PIXEL_MAX 255
+#define PIXEL_PRINT_WIDTH 4
+#else
+#error "SONAR_PIXEL_BITS must be 8 or 16"
+#endif
+
+#define IMAGE_ALIGNMENT 64
+#define ROTATION_BLOCK 8      // SIMD transpose micro-kernel is 8×8
+#define ROTATION_TILE 64      // cache tile walked block by block
+#define MAX_MATRIX_SIZE 16384
+#define MAX_PRINT_SIZE 16     // larger frames are not dumped as text
+
+#define MAX_WORKER_THREADS 64
+#define PARALLEL_MIN_PIXELS (1 << 20)  // smaller frames are filtered on one core
+#define MIN_BAND_ROWS 64
+
+#define PIPELINE_QUEUE_SIZE 8     // ring capacity, a power of two
+#define QUEUE_SPIN_LIMIT 128      // polls of a full or empty ring before blocking
+#define PIPELINE_FRAME_SLOTS 6    // frame buffers recycled through the pipeline
+
+#define LABEL_TILE 64             // connected-component labeling tile edge
+#define CHANGE_TILE 64            // frame-to-frame diff tile edge
+#define MAX_BLOBS_PER_FRAME 256   // largest blobs kept for tracking
+#define MAX_TRACKS 256
+#define TRACK_MAX_MISSED 3        // frames a track survives without a match
+
+#define BENCH_MIN_SIZE 64          // --bench frame edges grow ×4 from here
+#define BENCH_MIN_RUNS 3
+#define BENCH_MAX_RUNS 1000
+#define BENCH_MIN_MS 200.0        // keep repeating short kernels this long
+
+#define MAX_KERNEL_SIZE 15         // largest K for K×K convolution kernels
+
+#define BLOB_SURROUND_MARGIN 4    // width of the background ring around a blob
+
+// Largest radius for the running-sum box filter, whose window sums must
+// fit in 31 bits; larger windows are averaged from a summed-area table
+#if SONAR_PIXEL_BITS == 16
+#define MAX_FILTER_RADIUS 90
+#else
+#define MAX_FILTER_RADIUS 1024
+#endif
+
+// Sonar frame in one aligned allocation; rows start `stride` pixels apart
+typedef struct {
+    int width;
+    int height;
+    int stride;
+    Pixel *pixels;
+} SonarImage;
+
+static inline Pixel *imageRow(const SonarImage *image, int rowIndex) {
+    return image->pixels + (size_t)rowIndex * image->stride;
+}
+
+// Allocate a width×height image with rows padded to the alignment
+bool createImage(SonarImage *image, int width, int height) {
+    size_t rowBytes = ((size_t)width * sizeof(Pixel) + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+
+    image->width = width;
+    image->height = height;
+    image->stride = (int)(rowBytes / sizeof(Pixel));
+    image->pixels = (Pixel *)aligned_alloc(IMAGE_ALIGNMENT, rowBytes * height);
+    return image->pixels != NULL;
+}
+
+void freeImage(SonarImage *image) {
+    free(image->pixels);
+    image->pixels = NULL;
+}
+
+// Random intensity covering the full pixel range
+static inline Pixel randomPixel(void) {
+#if SONAR_PIXEL_BITS == 16
+    return (Pixel)((((unsigned)rand() << 15) ^ (unsigned)rand()) % (PIXEL_MAX + 1));
+#else
+    return (Pixel)(rand() % (PIXEL_MAX + 1));
+#endif
+}
+
+// Generate a random N×N matrix with values 0–PIXEL_MAX
+void generateRandomMatrix(SonarImage *image) {
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        Pixel *row = imageRow(image, rowIndex);
+        for (int colIndex = 0; colIndex < image->width; colIndex++) {
+            row[colIndex] = randomPixel();
+        }
+    }
+}
+
+// Print the matrix row by row
+void printMatrix(const SonarImage *image) {
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        const Pixel *row = imageRow(image, rowIndex);
+        for (int colIndex = 0; colIndex < image->width; colIndex++) {
+            printf("%*d", PIXEL_PRINT_WIDTH, row[colIndex]);
+        }
+        printf("\n");
+    }
+}
+
+// Write the transpose of the 8×8 block at src to dst (row j of dst is
+// column j of src). Strides are in pixels and may be negative, which lets
+// the rotations fold their row/column reversal into the transpose.
+static inline void transposeBlock8(const Pixel *src, ptrdiff_t srcStride, Pixel *dst, ptrdiff_t dstStride) {
+#if defined(__SSE2__) && SONAR_PIXEL_BITS == 8
+    __m128i r0 = _mm_loadl_epi64((const __m128i *)(src + 0 * srcStride));
+    __m128i r1 = _mm_loadl_epi64((const __m128i *)(src + 1 * srcStride));
+    __m128i r2 = _mm_loadl_epi64((const __m128i *)(src + 2 * srcStride));
+    __m128i r3 = _mm_loadl_epi64((const __m128i *)(src + 3 * srcStride));
+    __m128i r4 = _mm_loadl_epi64((const __m128i *)(src + 4 * srcStride));
+    __m128i r5 = _mm_loadl_epi64((const __m128i *)(src + 5 * srcStride));
+    __m128i r6 = _mm_loadl_epi64((const __m128i *)(src + 6 * srcStride));
+    __m128i r7 = _mm_loadl_epi64((const __m128i *)(src + 7 * srcStride));
+
+    __m128i a01 = _mm_unpacklo_epi8(r0, r1);
+    __m128i a23 = _mm_unpacklo_epi8(r2, r3);
+    __m128i a45 = _mm_unpacklo_epi8(r4, r5);
+    __m128i a67 = _mm_unpacklo_epi8(r6, r7);
+
+    __m128i b0 = _mm_unpacklo_epi16(a01, a23);
+    __m128i b1 = _mm_unpackhi_epi16(a01, a23);
+    __m128i b2 = _mm_unpacklo_epi16(a45, a67);
+    __m128i b3 = _mm_unpackhi_epi16(a45, a67);
+
+    __m128i c01 = _mm_unpacklo_epi32(b0, b2);
+    __m128i c23 = _mm_unpackhi_epi32(b0, b2);
+    __m128i c45 = _mm_unpacklo_epi32(b1, b3);
+    __m128i c67 = _mm_unpackhi_epi32(b1, b3);
+
+    _mm_storel_epi64((__m128i *)(dst + 0 * dstStride), c01);
+    _mm_storel_epi64((__m128i *)(dst + 1 * dstStride), _mm_srli_si128(c01, 8));
+    _mm_storel_epi64((__m128i *)(dst + 2 * dstStride), c23);
+    _mm_storel_epi64((__m128i *)(dst + 3 * dstStride), _mm_srli_si128(c23, 8));
+    _mm_storel_epi64((__m128i *)(dst + 4 * dstStride), c45);
+    _mm_storel_epi64((__m128i *)(dst + 5 * dstStride), _mm_srli_si128(c45, 8));
+    _mm_storel_epi64((__m128i *)(dst + 6 * dstStride), c67);
+    _mm_storel_epi64((__m128i *)(dst + 7 * dstStride), _mm_srli_si128(c67, 8));
+#elif defined(__SSE2__) && SONAR_PIXEL_BITS == 16
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(src + 0 * srcStride));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 1 * srcStride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * srcStride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * srcStride));
+    __m128i r4 = _mm_loadu_si128((const __m128i *)(src + 4 * srcStride));
+    __m128i r5 = _mm_loadu_si128((const __m128i *)(src + 5 * srcStride));
+    __m128i r6 = _mm_loadu_si128((const __m128i *)(src + 6 * srcStride));
+    __m128i r7 = _mm_loadu_si128((const __m128i *)(src + 7 * srcStride));
+
+    __m128i a0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i a1 = _mm_unpackhi_epi16(r0, r1);
+    __m128i a2 = _mm_unpacklo_epi16(r2, r3);
+    __m128i a3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i a4 = _mm_unpacklo_epi16(r4, r5);
+    __m128i a5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i a6 = _mm_unpacklo_epi16(r6, r7);
+    __m128i a7 = _mm_unpackhi_epi16(r6, r7);
+
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+    _mm_storeu_si128((__m128i *)(dst + 0 * dstStride), _mm_unpacklo_epi64(b0, b4));
+    _mm_storeu_si128((__m128i *)(dst + 1 * dstStride), _mm_unpackhi_epi64(b0, b4));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dstStride), _mm_unpacklo_epi64(b1, b5));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dstStride), _mm_unpackhi_epi64(b1, b5));
+    _mm_storeu_si128((__m128i *)(dst + 4 * dstStride), _mm_unpacklo_epi64(b2, b6));
+    _mm_storeu_si128((__m128i *)(dst + 5 * dstStride), _mm_unpackhi_epi64(b2, b6));
+    _mm_storeu_si128((__m128i *)(dst + 6 * dstStride), _mm_unpacklo_epi64(b3, b7));
+    _mm_storeu_si128((__m128i *)(dst + 7 * dstStride), _mm_unpackhi_epi64(b3, b7));
+#else
+    for (int j = 0; j < ROTATION_BLOCK; j++) {
+        for (int k = 0; k < ROTATION_BLOCK; k++) {
+            dst[j * dstStride + k] = src[k * srcStride + j];
+        }
+    }
+#endif
+}
+
+// Rotate one 8×8 source block at (rowIndex, colIndex) into dst
+static inline void rotateBlock(const SonarImage *src, SonarImage *dst, int degrees, int rowIndex, int colIndex) {
+    ptrdiff_t srcStride = src->stride, dstStride = dst->stride;
+
+    if (degrees == 90) {
+        // dst[c][H-1-r] = src[r][c]: transpose with the source rows walked bottom-up
+        transposeBlock8(imageRow(src, rowIndex + ROTATION_BLOCK - 1) + colIndex, -srcStride,
+                        imageRow(dst, colIndex) + (src->height - rowIndex - ROTATION_BLOCK), dstStride);
+    }
+    else {
+        // dst[W-1-c][r] = src[r][c]: transpose with the destination rows walked bottom-up
+        transposeBlock8(imageRow(src, rowIndex) + colIndex, srcStride,
+                        imageRow(dst, src->width - 1 - colIndex) + rowIndex, -dstStride);
+    }
+}
+
+// Scalar rotation of the source rectangle [row0,row1)×[col0,col1)
+static void rotatePixels(const SonarImage *src, SonarImage *dst, int degrees, int row0, int row1, int col0, int col1) {
+    for (int rowIndex = row0; rowIndex < row1; rowIndex++) {
+        const Pixel *row = imageRow(src, rowIndex);
+        for (int colIndex = col0; colIndex < col1; colIndex++) {
+            if (degrees == 90) imageRow(dst, colIndex)[src->height - 1 - rowIndex] = row[colIndex];
+            else imageRow(dst, src->width - 1 - colIndex)[rowIndex] = row[colIndex];
+        }
+    }
+}
+
+static void reverseRow(Pixel *row, int length) {
+    for (int left = 0, right = length - 1; left < right; left++, right--) {
+        Pixel temp = row[left];
+        row[left] = row[right];
+        row[right] = temp;
+    }
+}
+
+// Rotate src clockwise by 90, 180 or 270 degrees into dst (any shape).
+// dst must already be allocated with the rotated dimensions.
+bool rotateImage(const SonarImage *src, SonarImage *dst, int degrees) {
+    bool quarterTurn = degrees == 90 || degrees == 270;
+    if ((!quarterTurn && degrees != 180) ||
+        dst->width != (quarterTurn ? src->height : src->width) ||
+        dst->height != (quarterTurn ? src->width : src->height)) {
+        return false;
+    }
+
+    if (degrees == 180) {
+        for (int rowIndex = 0; rowIndex < src->height; rowIndex++) {
+            const Pixel *row = imageRow(src, rowIndex);
+            Pixel *target = imageRow(dst, src->height - 1 - rowIndex) + src->width - 1;
+            for (int colIndex = 0; colIndex < src->width; colIndex++) {
+                target[-colIndex] = row[colIndex];
+            }
+        }
+        return true;
+    }
+
+    int fullRows = src->height / ROTATION_BLOCK * ROTATION_BLOCK;
+    int fullCols = src->width / ROTATION_BLOCK * ROTATION_BLOCK;
+
+    for (int tileRow = 0; tileRow < fullRows; tileRow += ROTATION_TILE) {
+        int tileRowEnd = tileRow + ROTATION_TILE < fullRows ? tileRow + ROTATION_TILE : fullRows;
+        for (int tileCol = 0; tileCol < fullCols; tileCol += ROTATION_TILE) {
+            int tileColEnd = tileCol + ROTATION_TILE < fullCols ? tileCol + ROTATION_TILE : fullCols;
+            for (int rowIndex = tileRow; rowIndex < tileRowEnd; rowIndex += ROTATION_BLOCK) {
+                for (int colIndex = tileCol; colIndex < tileColEnd; colIndex += ROTATION_BLOCK) {
+                    rotateBlock(src, dst, degrees, rowIndex, colIndex);
+                }
+            }
+        }
+    }
+
+    // ragged right and bottom edges
+    rotatePixels(src, dst, degrees, 0, fullRows, fullCols, src->width);
+    rotatePixels(src, dst, degrees, fullRows, src->height, 0, src->width);
+    return true;
+}
+
+// Transpose a square image in place, swapping 8×8 blocks tile by tile
+static void transposeInPlace(SonarImage *image) {
+    int matrixSize = image->width;
+    int fullSize = matrixSize / ROTATION_BLOCK * ROTATION_BLOCK;
+    ptrdiff_t stride = image->stride;
+    Pixel saved[ROTATION_BLOCK * ROTATION_BLOCK];
+
+    for (int tileRow = 0; tileRow < fullSize; tileRow += ROTATION_TILE) {
+        int tileRowEnd = tileRow + ROTATION_TILE < fullSize ? tileRow + ROTATION_TILE : fullSize;
+        for (int tileCol = tileRow; tileCol < fullSize; tileCol += ROTATION_TILE) {
+            int tileColEnd = tileCol + ROTATION_TILE < fullSize ? tileCol + ROTATION_TILE : fullSize;
+            for (int rowIndex = tileRow; rowIndex < tileRowEnd; rowIndex += ROTATION_BLOCK) {
+                int firstCol = tileCol == tileRow ? rowIndex : tileCol;
+                for (int colIndex = firstCol; colIndex < tileColEnd; colIndex += ROTATION_BLOCK) {
+                    Pixel *upper = imageRow(image, rowIndex) + colIndex;
+                    Pixel *lower = imageRow(image, colIndex) + rowIndex;
+
+                    // saved = upperᵀ, upper = lowerᵀ, lower = saved
+                    transposeBlock8(upper, stride, saved, ROTATION_BLOCK);
+                    if (upper != lower) transposeBlock8(lower, stride, upper, stride);
+                    for (int j = 0; j < ROTATION_BLOCK; j++) {
+                        memcpy(lower + j * stride, saved + j * ROTATION_BLOCK, ROTATION_BLOCK * sizeof(Pixel));
+                    }
+                }
+            }
+        }
+    }
+
+    // pairs with a column past the last full block
     for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
-        for (int colIndex = 0; colIndex < matrixSize; colIndex++) {
-            *(*(matrixData + rowIndex) + colIndex) = rand() % 256;
+        Pixel *row = imageRow(image, rowIndex);
+        int firstCol = rowIndex + 1 > fullSize ? rowIndex + 1 : fullSize;
+        for (int colIndex = firstCol; colIndex < matrixSize; colIndex++) {
+            Pixel *mirrored = imageRow(image, colIndex) + rowIndex;
+            Pixel temp = row[colIndex];
+            row[colIndex] = *mirrored;
+            *mirrored = temp;
+        }
+    }
+}
+
+// swap rows a and b, reversing both when `reverse` is set
+static void swapRows(Pixel *rowA, Pixel *rowB, int length, bool reverse) {
+    if (!reverse) {
+        for (int colIndex = 0; colIndex < length; colIndex++) {
+            Pixel temp = rowA[colIndex];
+            rowA[colIndex] = rowB[colIndex];
+            rowB[colIndex] = temp;
+        }
+        return;
+    }
+    for (int colIndex = 0; colIndex < length; colIndex++) {
+        Pixel temp = rowA[colIndex];
+        rowA[colIndex] = rowB[length - 1 - colIndex];
+        rowB[length - 1 - colIndex] = temp;
+    }
+}
+
+// Rotate a square image clockwise by 90, 180 or 270 degrees in place
+bool rotateImageInPlace(SonarImage *image, int degrees) {
+    int matrixSize = image->width;
+    if (image->height != matrixSize || (degrees != 90 && degrees != 180 && degrees != 270)) return false;
+
+    if (degrees == 90) {
+        // transpose, then reverse each row
+        transposeInPlace(image);
+        for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
+            reverseRow(imageRow(image, rowIndex), matrixSize);
+        }
+    }
+    else if (degrees == 270) {
+        // transpose, then reverse the order of the rows
+        transposeInPlace(image);
+        for (int rowIndex = 0; rowIndex < matrixSize / 2; rowIndex++) {
+            swapRows(imageRow(image, rowIndex), imageRow(image, matrixSize - 1 - rowIndex), matrixSize, false);
+        }
+    }
+    else {
+        for (int rowIndex = 0; rowIndex < matrixSize / 2; rowIndex++) {
+            swapRows(imageRow(image, rowIndex), imageRow(image, matrixSize - 1 - rowIndex), matrixSize, true);
+        }
+        if (matrixSize % 2 == 1) reverseRow(imageRow(image, matrixSize / 2), matrixSize);
+    }
+    return true;
+}
+
+// Rotate the matrix 90° clockwise in-place (square images)
+void rotateMatrix90Clockwise(SonarImage *image) {
+    rotateImageInPlace(image, 90);
+}
+
+// Persistent worker pool for data-parallel loops. parallelFor hands out
+// task indices from an atomic counter; the calling thread works too.
+typedef void (*ParallelTask)(void *context, int taskIndex);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+    pthread_mutex_t jobLock;       // one parallelFor at a time
+    pthread_t threads[MAX_WORKER_THREADS];
+    int workerCount;               // threads besides the caller
+    bool started;
+    bool shuttingDown;
+    unsigned long generation;
+    int busyWorkers;
+    ParallelTask task;
+    void *context;
+    int taskCount;
+    atomic_int nextTask;
+    atomic_int slotsTaken;         // worker slots handed to pool threads
+} ThreadPool;
+
+static ThreadPool workerPool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .workReady = PTHREAD_COND_INITIALIZER,
+    .workDone = PTHREAD_COND_INITIALIZER,
+    .jobLock = PTHREAD_MUTEX_INITIALIZER,
+};
+static int requestedThreads = 0;            // 0 means one per online core
+static _Thread_local bool insideParallelTask = false;
+static _Thread_local int workerSlot = 0;    // 0 for callers, 1.. for pool threads
+
+static void runPendingTasks(ThreadPool *pool) {
+    int taskIndex;
+    while ((taskIndex = atomic_fetch_add(&pool->nextTask, 1)) < pool->taskCount) {
+        pool->task(pool->context, taskIndex);
+    }
+}
+
+static void *workerMain(void *argument) {
+    ThreadPool *pool = (ThreadPool *)argument;
+    unsigned long seenGeneration = 0;
+    insideParallelTask = true;
+    workerSlot = atomic_fetch_add(&pool->slotsTaken, 1) + 1;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->shuttingDown && pool->generation == seenGeneration) {
+            pthread_cond_wait(&pool->workReady, &pool->lock);
+        }
+        if (pool->shuttingDown) break;
+        seenGeneration = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        runPendingTasks(pool);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busyWorkers == 0) pthread_cond_signal(&pool->workDone);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+int workerThreadCount(void) {
+    if (requestedThreads > 0) return requestedThreads;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) return 1;
+    return online > MAX_WORKER_THREADS ? MAX_WORKER_THREADS : (int)online;
+}
+
+static void startWorkerPool(ThreadPool *pool) {
+    pool->shuttingDown = false;
+    pool->workerCount = 0;
+    atomic_store(&pool->slotsTaken, 0);
+    for (int i = 0; i < workerThreadCount() - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, workerMain, pool) != 0) break;
+        pool->workerCount++;
+    }
+    pool->started = true;
+}
+
+void shutdownWorkerPool(void) {
+    ThreadPool *pool = &workerPool;
+    pthread_mutex_lock(&pool->jobLock);
+    if (pool->started) {
+        pthread_mutex_lock(&pool->lock);
+        pool->shuttingDown = true;
+        pthread_cond_broadcast(&pool->workReady);
+        pthread_mutex_unlock(&pool->lock);
+        for (int i = 0; i < pool->workerCount; i++) {
+            pthread_join(pool->threads[i], NULL);
+        }
+        pool->started = false;
+    }
+    pthread_mutex_unlock(&pool->jobLock);
+}
+
+// Use `threads` threads (0 = all cores) for later parallel loops
+void setWorkerThreads(int threads) {
+    shutdownWorkerPool();
+    requestedThreads = threads < 0 ? 0 : (threads > MAX_WORKER_THREADS ? MAX_WORKER_THREADS : threads);
+}
+
+// Run task(context, i) for every i in [0, taskCount) across the pool
+void parallelFor(int taskCount, ParallelTask task, void *context) {
+    ThreadPool *pool = &workerPool;
+
+    // nested loops and single tasks run inline
+    if (taskCount <= 1 || insideParallelTask) {
+        for (int taskIndex = 0; taskIndex < taskCount; taskIndex++) task(context, taskIndex);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->jobLock);
+    if (!pool->started) startWorkerPool(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->context = context;
+    pool->taskCount = taskCount;
+    atomic_store(&pool->nextTask, 0);
+    pool->busyWorkers = pool->workerCount;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->lock);
+
+    insideParallelTask = true;
+    runPendingTasks(pool);
+    insideParallelTask = false;
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busyWorkers > 0) {
+        pthread_cond_wait(&pool->workDone, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->jobLock);
+}
+
+// Split `rows` rows into bands: a few per thread for load balance,
+// never thinner than MIN_BAND_ROWS
+int chooseBandCount(int rows, int width) {
+    if ((long long)rows * width < PARALLEL_MIN_PIXELS) return 1;
+    int bands = workerThreadCount() * 4;
+    if (bands > rows / MIN_BAND_ROWS) bands = rows / MIN_BAND_ROWS;
+    return bands < 1 ? 1 : bands;
+}
+
+// Exact floor(n / d) for n < 2^numeratorBits as a multiply and shift
+// (Granlund–Montgomery), so the per-pixel division vectorizes
+typedef struct {
+    uint64_t multiplier;
+    int shift;
+} Divider;
+
+static Divider makeDivider(uint32_t divisor, int numeratorBits) {
+    int log2Ceil = 0;
+    while ((1ULL << log2Ceil) < divisor) log2Ceil++;
+
+    Divider divider;
+    divider.shift = numeratorBits + log2Ceil;
+    divider.multiplier = ((1ULL << divider.shift) + divisor - 1) / divisor;
+    return divider;
+}
+
+// Summed-area table: sums[r][c] holds the total of all pixels above and
+// to the left of (r, c), so any rectangle sum is four lookups. Rows are
+// built from a 32-bit horizontal prefix (a row sum stays below 2^32)
+// added onto the 64-bit row above, both with SSE2 where available.
+typedef struct {
+    int width, height;
+    size_t stride;            // width + 1
+    uint64_t *sums;           // (height + 1) × (width + 1), first row and column zero
+    uint32_t *rowPrefix;
+} SummedAreaTable;
+
+void freeSummedAreaTable(SummedAreaTable *table) {
+    free(table->sums);
+    free(table->rowPrefix);
+    table->sums = NULL;
+    table->rowPrefix = NULL;
+}
+
+bool initSummedAreaTable(SummedAreaTable *table, int width, int height) {
+    table->width = width;
+    table->height = height;
+    table->stride = (size_t)width + 1;
+    table->sums = (uint64_t *)calloc(table->stride * (height + 1), sizeof(uint64_t));
+    table->rowPrefix = (uint32_t *)malloc((size_t)width * sizeof(uint32_t));
+    if (table->sums == NULL || table->rowPrefix == NULL) {
+        freeSummedAreaTable(table);
+        return false;
+    }
+    return true;
+}
+
+// Per-thread scratch for the filtering kernels, so a stream of frames does
+// not allocate per band. A workspace holds one set per thread that can run
+// a task: slot 0 for the thread calling parallelFor, the rest for the pool.
+// Kernels handed a NULL workspace allocate their own buffers per call.
+typedef struct {
+    SonarImage strip;          // ROTATION_TILE rows of the unrotated source
+    uint32_t *columnSums;      // BoxFilter sums, up to `edge` columns
+    uint32_t *prefix;
+    int32_t *ring;             // separable convolution rows, ringRows × edge
+} FilterScratch;
+
+typedef struct {
+    int edge;                  // longest frame side the buffers fit
+    int ringRows;              // largest kernel size the rings fit, 0 for none
+    int slotCount;
+    FilterScratch slots[MAX_WORKER_THREADS];
+    SummedAreaTable table;     // whole frame, only for radii beyond MAX_FILTER_RADIUS
+} FilterWorkspace;
+
+void freeFilterWorkspace(FilterWorkspace *workspace) {
+    for (int slot = 0; slot < workspace->slotCount; slot++) {
+        freeImage(&workspace->slots[slot].strip);
+        free(workspace->slots[slot].columnSums);
+        free(workspace->slots[slot].prefix);
+        free(workspace->slots[slot].ring);
+    }
+    freeSummedAreaTable(&workspace->table);
+    memset(workspace, 0, sizeof(*workspace));
+}
+
+// Buffers for width×height frames on every thread of the pool, with
+// convolution rings for kernels up to kernelSize (0 when none is used) and
+// a summed-area table when radius is beyond the running-sum filter
+bool initFilterWorkspace(FilterWorkspace *workspace, int width, int height, int kernelSize, int radius) {
+    memset(workspace, 0, sizeof(*workspace));
+    workspace->edge = width > height ? width : height;
+    workspace->ringRows = kernelSize;
+    workspace->slotCount = workerThreadCount();
+    for (int slot = 0; slot < workspace->slotCount; slot++) {
+        FilterScratch *scratch = &workspace->slots[slot];
+        scratch->columnSums = (uint32_t *)malloc((size_t)workspace->edge * sizeof(uint32_t));
+        scratch->prefix = (uint32_t *)malloc(((size_t)workspace->edge + 1) * sizeof(uint32_t));
+        if (kernelSize > 0) {
+            scratch->ring = (int32_t *)malloc((size_t)kernelSize * workspace->edge * sizeof(int32_t));
+        }
+        if (!createImage(&scratch->strip, workspace->edge, ROTATION_TILE) ||
+            scratch->columnSums == NULL || scratch->prefix == NULL || (kernelSize > 0 && scratch->ring == NULL)) {
+            freeFilterWorkspace(workspace);
+            return false;
+        }
+    }
+    if (radius > MAX_FILTER_RADIUS && !initSummedAreaTable(&workspace->table, width, height)) {
+        freeFilterWorkspace(workspace);
+        return false;
+    }
+    return true;
+}
+
+// A summed-area table for a width×height frame: the workspace's when it has
+// one that size, else `own`, newly allocated. NULL if that fails.
+static SummedAreaTable *frameTable(FilterWorkspace *workspace, SummedAreaTable *own, int width, int height) {
+    if (workspace != NULL && workspace->table.sums != NULL &&
+        workspace->table.width == width && workspace->table.height == height) {
+        return &workspace->table;
+    }
+    return initSummedAreaTable(own, width, height) ? own : NULL;
+}
+
+// The calling thread's scratch, or NULL when there is none that fits
+static FilterScratch *threadScratch(FilterWorkspace *workspace, int width) {
+    if (workspace == NULL || workerSlot >= workspace->slotCount || width > workspace->edge) return NULL;
+    return &workspace->slots[workerSlot];
+}
+
+// Running-sum box filter over the clipped (2r+1)×(2r+1) window. Each
+// output pixel is the window sum divided by the number of pixels inside
+// the image, exactly like the original edge-count averaging.
+typedef struct {
+    const SonarImage *src;
+    int radius;
+    int firstCol, lastCol;     // output columns [firstCol, lastCol)
+    int inputStart, inputEnd;  // input columns feeding them
+    int nextRow;               // output row produced by the next call
+    int numeratorBits;
+    uint32_t *columnSums;      // per input column, over the vertical window
+    uint32_t *prefix;          // prefix sums of columnSums (mod 2^32)
+    bool ownsBuffers;          // false when they belong to a FilterScratch
+} BoxFilter;
+
+static void addSourceRow(BoxFilter *filter, int rowIndex, int sign) {
+    const Pixel *row = imageRow(filter->src, rowIndex) + filter->inputStart;
+    int count = filter->inputEnd - filter->inputStart;
+    uint32_t *sums = filter->columnSums;
+
+    if (sign > 0) {
+        for (int i = 0; i < count; i++) sums[i] += row[i];
+    }
+    else {
+        for (int i = 0; i < count; i++) sums[i] -= row[i];
+    }
+}
+
+void boxFilterEnd(BoxFilter *filter) {
+    if (filter->ownsBuffers) {
+        free(filter->columnSums);
+        free(filter->prefix);
+    }
+    filter->columnSums = filter->prefix = NULL;
+}
+
+// Prepare to produce columns [firstCol, lastCol) starting at firstRow; the
+// sums live in scratch when one is given, so only then it cannot fail
+bool boxFilterBegin(BoxFilter *filter, const SonarImage *src, int radius, int firstCol, int lastCol, int firstRow,
+                    FilterScratch *scratch) {
+    filter->src = src;
+    filter->radius = radius;
+    filter->firstCol = firstCol;
+    filter->lastCol = lastCol;
+    filter->inputStart = firstCol - radius > 0 ? firstCol - radius : 0;
+    filter->inputEnd = lastCol + radius < src->width ? lastCol + radius : src->width;
+    filter->nextRow = firstRow;
+
+    uint64_t maxSum = (uint64_t)PIXEL_MAX * (2 * radius + 1) * (2 * radius + 1);
+    filter->numeratorBits = 1;
+    while ((1ULL << filter->numeratorBits) <= maxSum) filter->numeratorBits++;
+
+    int inputCount = filter->inputEnd - filter->inputStart;
+    filter->ownsBuffers = scratch == NULL;
+    if (scratch != NULL) {
+        filter->columnSums = scratch->columnSums;
+        filter->prefix = scratch->prefix;
+        memset(filter->columnSums, 0, (size_t)inputCount * sizeof(uint32_t));
+    }
+    else {
+        filter->columnSums = (uint32_t *)calloc(inputCount, sizeof(uint32_t));
+        filter->prefix = (uint32_t *)malloc((inputCount + 1) * sizeof(uint32_t));
+        if (filter->columnSums == NULL || filter->prefix == NULL) {
+            boxFilterEnd(filter);
+            return false;
+        }
+    }
+
+    int top = firstRow - radius > 0 ? firstRow - radius : 0;
+    int bottom = firstRow + radius < src->height - 1 ? firstRow + radius : src->height - 1;
+    for (int rowIndex = top; rowIndex <= bottom; rowIndex++) {
+        addSourceRow(filter, rowIndex, 1);
+    }
+    return true;
+}
+
+// Write the next output row (columns firstCol.. into output[0..]) and advance
+void boxFilterRow(BoxFilter *filter, Pixel *output) {
+    const SonarImage *src = filter->src;
+    int radius = filter->radius;
+    int rowIndex = filter->nextRow++;
+
+    int top = rowIndex - radius > 0 ? rowIndex - radius : 0;
+    int bottom = rowIndex + radius < src->height - 1 ? rowIndex + radius : src->height - 1;
+    uint32_t rowsInWindow = bottom - top + 1;
+
+    // horizontal prefix over the column sums
+    int inputCount = filter->inputEnd - filter->inputStart;
+    uint32_t *prefix = filter->prefix;
+    prefix[0] = 0;
+    for (int i = 0; i < inputCount; i++) {
+        prefix[i + 1] = prefix[i] + filter->columnSums[i];
+    }
+
+    // interior columns see the full window width: branch-free and vectorizable
+    int interiorStart = filter->firstCol > radius ? filter->firstCol : radius;
+    int interiorEnd = filter->lastCol < src->width - radius ? filter->lastCol : src->width - radius;
+    if (interiorEnd < interiorStart) interiorStart = interiorEnd = filter->firstCol;
+
+    for (int colIndex = filter->firstCol; colIndex < interiorStart; colIndex++) {
+        int left = colIndex - radius > 0 ? colIndex - radius : 0;
+        int right = colIndex + radius < src->width - 1 ? colIndex + radius : src->width - 1;
+        uint32_t sum = prefix[right + 1 - filter->inputStart] - prefix[left - filter->inputStart];
+        output[colIndex - filter->firstCol] = (Pixel)(sum / (rowsInWindow * (right - left + 1)));
+    }
+
+    Divider divider = makeDivider(rowsInWindow * (2 * radius + 1), filter->numeratorBits);
+    int upperOffset = radius + 1 - filter->inputStart;
+    int lowerOffset = -radius - filter->inputStart;
+    for (int colIndex = interiorStart; colIndex < interiorEnd; colIndex++) {
+        uint32_t sum = prefix[colIndex + upperOffset] - prefix[colIndex + lowerOffset];
+        output[colIndex - filter->firstCol] = (Pixel)(((uint64_t)sum * divider.multiplier) >> divider.shift);
+    }
+
+    for (int colIndex = interiorEnd > filter->firstCol ? interiorEnd : filter->firstCol; colIndex < filter->lastCol; colIndex++) {
+        int left = colIndex - radius > 0 ? colIndex - radius : 0;
+        int right = colIndex + radius < src->width - 1 ? colIndex + radius : src->width - 1;
+        uint32_t sum = prefix[right + 1 - filter->inputStart] - prefix[left - filter->inputStart];
+        output[colIndex - filter->firstCol] = (Pixel)(sum / (rowsInWindow * (right - left + 1)));
+    }
+
+    // slide the vertical window down one row
+    if (rowIndex + 1 < src->height) {
+        if (rowIndex + 1 + radius < src->height) addSourceRow(filter, rowIndex + 1 + radius, 1);
+        if (rowIndex - radius >= 0) addSourceRow(filter, rowIndex - radius, -1);
+    }
+}
+
+// Box-filter the rectangle [x0,x1)×[y0,y1) of src into the same place in
+// dst, with the calling thread's buffers from workspace unless it is NULL
+bool boxFilterRegion(const SonarImage *src, SonarImage *dst, int radius, int x0, int y0, int x1, int y1,
+                     FilterWorkspace *workspace) {
+    BoxFilter filter;
+    if (!boxFilterBegin(&filter, src, radius, x0, x1, y0, threadScratch(workspace, src->width))) return false;
+
+    for (int rowIndex = y0; rowIndex < y1; rowIndex++) {
+        boxFilterRow(&filter, imageRow(dst, rowIndex) + x0);
+    }
+    boxFilterEnd(&filter);
+    return true;
+}
+
+// prefix[c] = row[0] + ... + row[c]
+static void prefixSumRow(const Pixel *row, uint32_t *prefix, int width) {
+    int colIndex = 0;
+    uint32_t running = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    __m128i carry = zero;
+    for (; colIndex + 4 <= width; colIndex += 4) {
+#if SONAR_PIXEL_BITS == 16
+        __m128i values = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(row + colIndex)), zero);
+#else
+        int32_t packed;
+        memcpy(&packed, row + colIndex, sizeof(packed));
+        __m128i values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+#endif
+        // in-register scan of four lanes, then add the carry from the left
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 4));
+        values = _mm_add_epi32(values, _mm_slli_si128(values, 8));
+        values = _mm_add_epi32(values, carry);
+        _mm_storeu_si128((__m128i *)(prefix + colIndex), values);
+        carry = _mm_shuffle_epi32(values, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    if (colIndex > 0) running = prefix[colIndex - 1];
+#endif
+    for (; colIndex < width; colIndex++) {
+        running += row[colIndex];
+        prefix[colIndex] = running;
+    }
+}
+
+// out[c] = above[c] + prefix[c]
+static void accumulateRow(const uint64_t *above, const uint32_t *prefix, uint64_t *out, int width) {
+    int colIndex = 0;
+#if defined(__SSE2__)
+    __m128i zero = _mm_setzero_si128();
+    for (; colIndex + 2 <= width; colIndex += 2) {
+        __m128i widened = _mm_unpacklo_epi32(_mm_loadl_epi64((const __m128i *)(prefix + colIndex)), zero);
+        __m128i total = _mm_add_epi64(_mm_loadu_si128((const __m128i *)(above + colIndex)), widened);
+        _mm_storeu_si128((__m128i *)(out + colIndex), total);
+    }
+#endif
+    for (; colIndex < width; colIndex++) {
+        out[colIndex] = above[colIndex] + prefix[colIndex];
+    }
+}
+
+// image must match the table's dimensions
+void buildSummedAreaTable(SummedAreaTable *table, const SonarImage *image) {
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        prefixSumRow(imageRow(image, rowIndex), table->rowPrefix, image->width);
+        const uint64_t *above = table->sums + (size_t)rowIndex * table->stride + 1;
+        accumulateRow(above, table->rowPrefix, (uint64_t *)above + table->stride, image->width);
+    }
+}
+
+// Sum over columns [x0, x1) and rows [y0, y1); the rectangle must lie inside the image
+static inline uint64_t rectangleSum(const SummedAreaTable *table, int x0, int y0, int x1, int y1) {
+    const uint64_t *top = table->sums + (size_t)y0 * table->stride;
+    const uint64_t *bottom = table->sums + (size_t)y1 * table->stride;
+    return bottom[x1] - bottom[x0] - top[x1] + top[x0];
+}
+
+// Mean over a rectangle clipped to the image; 0 when the clip is empty
+double rectangleMean(const SummedAreaTable *table, int x0, int y0, int x1, int y1) {
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > table->width) x1 = table->width;
+    if (y1 > table->height) y1 = table->height;
+    if (x1 <= x0 || y1 <= y0) return 0;
+    return (double)rectangleSum(table, x0, y0, x1, y1) / ((double)(x1 - x0) * (y1 - y0));
+}
+
+// One row of the clipped (2r+1)×(2r+1) mean, the same values the
+// running-sum filter produces, for any radius
+static void summedAreaSmoothRow(const SummedAreaTable *table, int rowIndex, int radius, Pixel *output) {
+    int top = rowIndex - radius > 0 ? rowIndex - radius : 0;
+    int bottom = rowIndex + radius + 1 < table->height ? rowIndex + radius + 1 : table->height;
+    uint64_t rows = bottom - top;
+
+    for (int colIndex = 0; colIndex < table->width; colIndex++) {
+        int left = colIndex - radius > 0 ? colIndex - radius : 0;
+        int right = colIndex + radius + 1 < table->width ? colIndex + radius + 1 : table->width;
+        output[colIndex] = (Pixel)(rectangleSum(table, left, top, right, bottom) / (rows * (right - left)));
+    }
+}
+
+typedef struct {
+    const SummedAreaTable *table;
+    SonarImage *dst;
+    int radius;
+    int bandCount;
+} SummedAreaJob;
+
+static void summedAreaBand(void *context, int bandIndex) {
+    SummedAreaJob *job = (SummedAreaJob *)context;
+    int height = job->table->height;
+    int firstRow = (int)((long long)height * bandIndex / job->bandCount);
+    int lastRow = (int)((long long)height * (bandIndex + 1) / job->bandCount);
+
+    for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+        summedAreaSmoothRow(job->table, rowIndex, job->radius, imageRow(job->dst, rowIndex));
+    }
+}
+
+// Box filter of any radius through a summed-area table
+bool summedAreaSmooth(const SonarImage *src, SonarImage *dst, int radius, FilterWorkspace *workspace) {
+    SummedAreaTable own;
+    SummedAreaTable *table = frameTable(workspace, &own, src->width, src->height);
+    if (table == NULL) return false;
+    buildSummedAreaTable(table, src);
+
+    SummedAreaJob job = {table, dst, radius, chooseBandCount(src->height, src->width)};
+    parallelFor(job.bandCount, summedAreaBand, &job);
+    if (table == &own) freeSummedAreaTable(&own);
+    return true;
+}
+
+typedef struct {
+    const SonarImage *src;
+    SonarImage *dst;
+    int radius;
+    int bandCount;
+    atomic_bool failed;
+    FilterWorkspace *workspace;
+} BoxFilterJob;
+
+// One horizontal band; its halo rows come from the shared, read-only source
+static void boxFilterBand(void *context, int bandIndex) {
+    BoxFilterJob *job = (BoxFilterJob *)context;
+    int height = job->src->height;
+    int firstRow = (int)((long long)height * bandIndex / job->bandCount);
+    int lastRow = (int)((long long)height * (bandIndex + 1) / job->bandCount);
+
+    if (!boxFilterRegion(job->src, job->dst, job->radius, 0, firstRow, job->src->width, lastRow, job->workspace)) {
+        atomic_store(&job->failed, true);
+    }
+}
+
+// Out-of-place (2r+1)×(2r+1) box filter; dst must match src in size.
+// Large frames are split into bands filtered in parallel, with buffers
+// from workspace unless it is NULL.
+bool applyBoxFilter(const SonarImage *src, SonarImage *dst, int radius, FilterWorkspace *workspace) {
+    if (radius > MAX_FILTER_RADIUS) return summedAreaSmooth(src, dst, radius, workspace);
+
+    BoxFilterJob job = {src, dst, radius, chooseBandCount(src->height, src->width), false, workspace};
+    parallelFor(job.bandCount, boxFilterBand, &job);
+    return !atomic_load(&job.failed);
+}
+
+bool copyImage(const SonarImage *src, SonarImage *dst) {
+    if (!createImage(dst, src->width, src->height)) return false;
+    memcpy(dst->pixels, src->pixels, (size_t)src->stride * src->height * sizeof(Pixel));
+    return true;
+}
+
+// Apply (2r+1)×(2r+1) smoothing filter in place
+void applySmoothingFilterRadius(SonarImage *image, int radius) {
+    SonarImage source;
+    if (!copyImage(image, &source)) {
+        printf("Memory allocation failed while copying the frame!\n");
+        return;
+    }
+    if (!applyBoxFilter(&source, image, radius, NULL)) {
+        printf("Memory allocation failed while creating filter buffers!\n");
+    }
+    freeImage(&source);
+}
+
+// Apply 3×3 smoothing filter 
+void applySmoothingFilter(SonarImage *image) {
+    applySmoothingFilterRadius(image, 1);
+}
+
+// Fused rotate-and-smooth. The clipped box window is symmetric under
+// quarter turns, so smoothing then rotating gives exactly the same pixels
+// as rotating then smoothing. Each band filters a ROTATION_TILE-row strip
+// of the unrotated source into a small cache-resident buffer and rotates
+// it straight into dst, so the full-size rotated intermediate is never
+// written or read back.
+typedef struct {
+    const SonarImage *src;
+    SonarImage *dst;
+    int degrees;
+    int radius;
+    const SummedAreaTable *table;   // set for radii beyond MAX_FILTER_RADIUS
+    int bandCount;
+    atomic_bool failed;
+    FilterWorkspace *workspace;
+} RotateSmoothJob;
+
+// The part of dst that receives source rows [firstRow, firstRow + rows)
+static SonarImage rotatedRowsView(const SonarImage *src, const SonarImage *dst, int degrees, int firstRow, int rows) {
+    SonarImage view = *dst;
+    if (degrees == 90) {
+        view.width = rows;
+        view.pixels = dst->pixels + (src->height - firstRow - rows);
+    }
+    else if (degrees == 270) {
+        view.width = rows;
+        view.pixels = dst->pixels + firstRow;
+    }
+    else {
+        view.height = rows;
+        view.pixels = imageRow(dst, src->height - firstRow - rows);
+    }
+    return view;
+}
+
+static void rotateSmoothBand(void *context, int bandIndex) {
+    RotateSmoothJob *job = (RotateSmoothJob *)context;
+    const SonarImage *src = job->src;
+    int firstRow = (int)((long long)src->height * bandIndex / job->bandCount);
+    int lastRow = (int)((long long)src->height * (bandIndex + 1) / job->bandCount);
+
+    FilterScratch *scratch = threadScratch(job->workspace, src->width);
+    SonarImage strip;
+    BoxFilter filter;
+    if (scratch != NULL) {
+        strip = scratch->strip;
+        strip.width = src->width;
+    }
+    else if (!createImage(&strip, src->width, ROTATION_TILE)) {
+        atomic_store(&job->failed, true);
+        return;
+    }
+    if (job->table == NULL && !boxFilterBegin(&filter, src, job->radius, 0, src->width, firstRow, scratch)) {
+        if (scratch == NULL) freeImage(&strip);
+        atomic_store(&job->failed, true);
+        return;
+    }
+
+    for (int stripRow = firstRow; stripRow < lastRow; stripRow += ROTATION_TILE) {
+        strip.height = lastRow - stripRow < ROTATION_TILE ? lastRow - stripRow : ROTATION_TILE;
+        for (int rowIndex = 0; rowIndex < strip.height; rowIndex++) {
+            Pixel *output = imageRow(&strip, rowIndex);
+            if (job->table != NULL) summedAreaSmoothRow(job->table, stripRow + rowIndex, job->radius, output);
+            else boxFilterRow(&filter, output);
+        }
+        SonarImage target = rotatedRowsView(src, job->dst, job->degrees, stripRow, strip.height);
+        rotateImage(&strip, &target, job->degrees);
+    }
+
+    if (job->table == NULL) boxFilterEnd(&filter);
+    if (scratch == NULL) freeImage(&strip);
+}
+
+// Rotate src clockwise by 90, 180 or 270 degrees and apply the
+// (2r+1)×(2r+1) box filter in one pass; dst has the rotated dimensions.
+// Matches rotateImage followed by applyBoxFilter bit for bit. The bands
+// take their buffers from workspace unless it is NULL.
+bool rotateAndSmoothImage(const SonarImage *src, SonarImage *dst, int degrees, int radius,
+                          FilterWorkspace *workspace) {
+    bool quarterTurn = degrees == 90 || degrees == 270;
+    if ((!quarterTurn && degrees != 180) ||
+        dst->width != (quarterTurn ? src->height : src->width) ||
+        dst->height != (quarterTurn ? src->width : src->height)) {
+        return false;
+    }
+
+    SummedAreaTable own;
+    SummedAreaTable *table = NULL;
+    if (radius > MAX_FILTER_RADIUS) {
+        table = frameTable(workspace, &own, src->width, src->height);
+        if (table == NULL) return false;
+        buildSummedAreaTable(table, src);
+    }
+
+    RotateSmoothJob job = {src, dst, degrees, radius, table, chooseBandCount(src->height, src->width), false,
+                           workspace};
+    parallelFor(job.bandCount, rotateSmoothBand, &job);
+    if (table == &own) freeSummedAreaTable(&own);
+    return !atomic_load(&job.failed);
+}
+
+// K×K integer convolution with clamp-to-edge borders:
+// out = min(|Σ w·p| / divisor, PIXEL_MAX), so signed kernels such as Sobel
+// give edge magnitudes. Rank-one kernels (Gaussian, box, Sobel) are run as
+// a horizontal and a vertical 1D pass; scaling by the pivot keeps that
+// integer-exact, so both paths produce the same pixels.
+typedef struct {
+    char name[32];
+    int size;                     // odd, 1..MAX_KERNEL_SIZE
+    int32_t weights[MAX_KERNEL_SIZE * MAX_KERNEL_SIZE];
+    int32_t divisor;
+    bool separable;
+    int32_t columnWeights[MAX_KERNEL_SIZE];
+    int32_t rowWeights[MAX_KERNEL_SIZE];
+    int64_t separableDivisor;     // divisor × |pivot|
+} ConvolutionKernel;
+
+static inline Pixel convolutionResult(int64_t sum, int64_t divisor) {
+    if (sum < 0) sum = -sum;
+    sum /= divisor;
+    return sum > PIXEL_MAX ? PIXEL_MAX : (Pixel)sum;
+}
+
+static inline int clampIndex(int index, int count) {
+    return index < 0 ? 0 : index >= count ? count - 1 : index;
+}
+
+// Interior-column loops; K is a constant in the 3/5/7 versions so the
+// compiler can unroll them, and the runtime kernel size in the generic one
+#define DEFINE_CONVOLUTION_KERNELS(SUFFIX, K)                                                        \
+static void convolveRow##SUFFIX(int size, const Pixel *const *rows, const int32_t *weights,         \
+                                int64_t divisor, Pixel *output, int firstCol, int lastCol) {        \
+    (void)size;                                                                                      \
+    for (int colIndex = firstCol; colIndex < lastCol; colIndex++) {                                  \
+        int32_t sum = 0;                                                                             \
+        for (int i = 0; i < (K); i++) {                                                              \
+            const Pixel *row = rows[i] + colIndex - (K) / 2;                                         \
+            for (int j = 0; j < (K); j++) sum += weights[i * (K) + j] * row[j];                      \
+        }                                                                                            \
+        output[colIndex] = convolutionResult(sum, divisor);                                          \
+    }                                                                                                \
+}                                                                                                    \
+static void horizontalPass##SUFFIX(int size, const Pixel *row, const int32_t *weights,              \
+                                   int32_t *output, int firstCol, int lastCol) {                    \
+    (void)size;                                                                                      \
+    for (int colIndex = firstCol; colIndex < lastCol; colIndex++) {                                  \
+        const Pixel *window = row + colIndex - (K) / 2;                                              \
+        int32_t sum = 0;                                                                             \
+        for (int j = 0; j < (K); j++) sum += weights[j] * window[j];                                 \
+        output[colIndex] = sum;                                                                      \
+    }                                                                                                \
+}                                                                                                    \
+static void verticalPass##SUFFIX(int size, const int32_t *const *rows, const int32_t *weights,      \
+                                 int64_t divisor, Pixel *output, int width) {                       \
+    (void)size;                                                                                      \
+    for (int colIndex = 0; colIndex < width; colIndex++) {                                           \
+        int64_t sum = 0;                                                                             \
+        for (int i = 0; i < (K); i++) sum += (int64_t)weights[i] * rows[i][colIndex];                \
+        output[colIndex] = convolutionResult(sum, divisor);                                          \
+    }                                                                                                \
+}
+
+DEFINE_CONVOLUTION_KERNELS(3, 3)
+DEFINE_CONVOLUTION_KERNELS(5, 5)
+DEFINE_CONVOLUTION_KERNELS(7, 7)
+DEFINE_CONVOLUTION_KERNELS(Generic, size)
+
+typedef struct {
+    void (*convolveRow)(int, const Pixel *const *, const int32_t *, int64_t, Pixel *, int, int);
+    void (*horizontalPass)(int, const Pixel *, const int32_t *, int32_t *, int, int);
+    void (*verticalPass)(int, const int32_t *const *, const int32_t *, int64_t, Pixel *, int);
+} ConvolutionRoutines;
+
+static ConvolutionRoutines convolutionRoutines(int size) {
+    switch (size) {
+        case 3: return (ConvolutionRoutines){convolveRow3, horizontalPass3, verticalPass3};
+        case 5: return (ConvolutionRoutines){convolveRow5, horizontalPass5, verticalPass5};
+        case 7: return (ConvolutionRoutines){convolveRow7, horizontalPass7, verticalPass7};
+        default: return (ConvolutionRoutines){convolveRowGeneric, horizontalPassGeneric, verticalPassGeneric};
+    }
+}
+
+// Check the weight range and detect rank-one kernels
+bool finalizeKernel(ConvolutionKernel *kernel) {
+    int size = kernel->size;
+    if (size < 1 || size > MAX_KERNEL_SIZE || size % 2 == 0 || kernel->divisor <= 0) return false;
+
+    int64_t weightTotal = 0;
+    int pivotRow = -1, pivotCol = -1;
+    for (int i = 0; i < size * size; i++) {
+        int32_t weight = kernel->weights[i];
+        weightTotal += weight < 0 ? -(int64_t)weight : weight;
+        if (pivotRow < 0 && weight != 0) {
+            pivotRow = i / size;
+            pivotCol = i % size;
+        }
+    }
+
+    // rank one iff w[i][j]·w[p][q] == w[i][q]·w[p][j] for the pivot (p, q)
+    kernel->separable = pivotRow >= 0;
+    for (int i = 0; i < size && kernel->separable; i++) {
+        for (int j = 0; j < size; j++) {
+            int64_t product = (int64_t)kernel->weights[i * size + j] * kernel->weights[pivotRow * size + pivotCol];
+            int64_t cross = (int64_t)kernel->weights[i * size + pivotCol] * kernel->weights[pivotRow * size + j];
+            if (product != cross) {
+                kernel->separable = false;
+                break;
+            }
+        }
+    }
+    if (kernel->separable) {
+        int32_t pivot = kernel->weights[pivotRow * size + pivotCol];
+        for (int i = 0; i < size; i++) {
+            kernel->columnWeights[i] = kernel->weights[i * size + pivotCol];
+            kernel->rowWeights[i] = kernel->weights[pivotRow * size + i];
+        }
+        kernel->separableDivisor = (int64_t)kernel->divisor * (pivot < 0 ? -(int64_t)pivot : pivot);
+
+        // the horizontal pass accumulates in 32 bits, the vertical one in 64
+        weightTotal = 0;
+        for (int j = 0; j < size; j++) {
+            weightTotal += kernel->rowWeights[j] < 0 ? -(int64_t)kernel->rowWeights[j] : kernel->rowWeights[j];
+        }
+    }
+    // the direct path accumulates in 32 bits
+    return weightTotal * PIXEL_MAX <= INT32_MAX;
+}
+
+// Binomial approximation of a Gaussian, normalized to unit gain
+static void makeGaussianKernel(ConvolutionKernel *kernel, int size) {
+    int32_t binomial[MAX_KERNEL_SIZE] = {1};
+    for (int n = 1; n < size; n++) {
+        for (int k = n; k > 0; k--) binomial[k] += binomial[k - 1];
+    }
+    kernel->size = size;
+    kernel->divisor = 0;
+    for (int i = 0; i < size; i++) {
+        for (int j = 0; j < size; j++) {
+            kernel->weights[i * size + j] = binomial[i] * binomial[j];
+            kernel->divisor += binomial[i] * binomial[j];
+        }
+    }
+}
+
+// Sobel gradient scaled by 1/4 so the magnitude stays within the pixel range
+static void makeSobelKernel(ConvolutionKernel *kernel, bool horizontal) {
+    static const int32_t smooth[3] = {1, 2, 1}, derivative[3] = {-1, 0, 1};
+    kernel->size = 3;
+    kernel->divisor = 4;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            kernel->weights[i * 3 + j] = horizontal ? smooth[i] * derivative[j] : derivative[i] * smooth[j];
+        }
+    }
+}
+
+// gaussianK, boxK, sobel-x, sobel-y, or K×K comma-separated weights with
+// an optional "/divisor" (default: the weight sum, or 1 if that is <= 0)
+bool parseKernelSpec(const char *text, ConvolutionKernel *kernel) {
+    int size;
+    char extra;
+    memset(kernel, 0, sizeof(*kernel));
+    snprintf(kernel->name, sizeof(kernel->name), "%s", text);
+
+    if (sscanf(text, "gaussian%d%c", &size, &extra) == 1) {
+        if (size < 1 || size > MAX_KERNEL_SIZE || size % 2 == 0) return false;
+        makeGaussianKernel(kernel, size);
+    }
+    else if (sscanf(text, "box%d%c", &size, &extra) == 1) {
+        if (size < 1 || size > MAX_KERNEL_SIZE || size % 2 == 0) return false;
+        kernel->size = size;
+        kernel->divisor = size * size;
+        for (int i = 0; i < size * size; i++) kernel->weights[i] = 1;
+    }
+    else if (strcmp(text, "sobel-x") == 0 || strcmp(text, "sobel-y") == 0) {
+        makeSobelKernel(kernel, text[6] == 'x');
+    }
+    else {
+        int count = 0;
+        int64_t weightSum = 0;
+        const char *cursor = text;
+        char *end;
+        while (count < MAX_KERNEL_SIZE * MAX_KERNEL_SIZE) {
+            long weight = strtol(cursor, &end, 10);
+            if (end == cursor || weight < INT16_MIN || weight > INT16_MAX) return false;
+            kernel->weights[count++] = (int32_t)weight;
+            weightSum += weight;
+            cursor = end;
+            if (*cursor != ',') break;
+            cursor++;
+        }
+
+        size = 1;
+        while (size * size < count) size += 2;
+        if (size * size != count) return false;
+        kernel->size = size;
+        kernel->divisor = weightSum > 0 && weightSum <= INT32_MAX ? (int32_t)weightSum : 1;
+
+        if (*cursor == '/') {
+            long divisor = strtol(cursor + 1, &end, 10);
+            if (end == cursor + 1 || divisor <= 0 || divisor > INT32_MAX) return false;
+            kernel->divisor = (int32_t)divisor;
+            cursor = end;
+        }
+        if (*cursor != '\0') return false;
+    }
+    return finalizeKernel(kernel);
+}
+
+// weighted sum at one column with clamped horizontal indices
+static int32_t clampedRowSum(const Pixel *row, const int32_t *weights, int size, int colIndex, int width) {
+    int32_t sum = 0;
+    for (int j = 0; j < size; j++) {
+        sum += weights[j] * row[clampIndex(colIndex + j - size / 2, width)];
+    }
+    return sum;
+}
+
+typedef struct {
+    const SonarImage *src;
+    SonarImage *dst;
+    const ConvolutionKernel *kernel;
+    int bandCount;
+    atomic_bool failed;
+    int firstCol, lastCol;        // columns written, the whole width for convolveImage
+    FilterWorkspace *workspace;   // rings for separable kernels, NULL to allocate them
+} ConvolutionJob;
+
+// Columns of [firstCol, lastCol) far enough from the edges to need no
+// clamping: [*interiorStart, *interiorStop), possibly empty
+static void interiorColumns(const ConvolutionJob *job, int *interiorStart, int *interiorStop) {
+    int radius = job->kernel->size / 2, width = job->src->width;
+    int interiorEnd = width - radius > radius ? width - radius : radius;
+    *interiorStart = job->firstCol > radius ? job->firstCol : radius;
+    *interiorStop = job->lastCol < interiorEnd ? job->lastCol : interiorEnd;
+    if (*interiorStop < *interiorStart) *interiorStop = *interiorStart;
+}
+
+static void convolveDirectRows(const ConvolutionJob *job, int firstRow, int lastRow) {
+    const SonarImage *src = job->src;
+    const ConvolutionKernel *kernel = job->kernel;
+    int size = kernel->size, radius = size / 2, width = src->width;
+    int interiorStart, interiorStop;
+    interiorColumns(job, &interiorStart, &interiorStop);
+    ConvolutionRoutines routines = convolutionRoutines(size);
+    const Pixel *rows[MAX_KERNEL_SIZE];
+
+    for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+        Pixel *output = imageRow(job->dst, rowIndex);
+        for (int i = 0; i < size; i++) {
+            rows[i] = imageRow(src, clampIndex(rowIndex + i - radius, src->height));
+        }
+
+        routines.convolveRow(size, rows, kernel->weights, kernel->divisor, output, interiorStart, interiorStop);
+        for (int colIndex = job->firstCol; colIndex < job->lastCol; colIndex++) {
+            if (colIndex == interiorStart) colIndex = interiorStop;
+            if (colIndex >= job->lastCol) break;
+            int32_t sum = 0;
+            for (int i = 0; i < size; i++) {
+                sum += clampedRowSum(rows[i], kernel->weights + i * size, size, colIndex, width);
+            }
+            output[colIndex] = convolutionResult(sum, kernel->divisor);
+        }
+    }
+}
+
+// Horizontal results live in a ring of `size` rows keyed by source row,
+// so each source row is filtered once per band. Only fails when the job
+// has no workspace ring and allocating one fails.
+static bool convolveSeparableRows(const ConvolutionJob *job, int firstRow, int lastRow) {
+    const SonarImage *src = job->src;
+    const ConvolutionKernel *kernel = job->kernel;
+    int size = kernel->size, radius = size / 2, width = src->width;
+    int interiorStart, interiorStop;
+    interiorColumns(job, &interiorStart, &interiorStop);
+    ConvolutionRoutines routines = convolutionRoutines(size);
+
+    FilterScratch *scratch = threadScratch(job->workspace, width);
+    bool ownRing = scratch == NULL || size > job->workspace->ringRows;
+    int32_t *ring = ownRing ? (int32_t *)malloc((size_t)size * width * sizeof(int32_t)) : scratch->ring;
+    if (ring == NULL) return false;
+    int ringRows[MAX_KERNEL_SIZE];
+    const int32_t *rows[MAX_KERNEL_SIZE];
+    for (int slot = 0; slot < size; slot++) ringRows[slot] = -1;
+
+    for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+        for (int i = 0; i < size; i++) {
+            int sourceRow = clampIndex(rowIndex + i - radius, src->height);
+            int slot = sourceRow % size;
+            int32_t *filtered = ring + (size_t)slot * width;
+
+            if (ringRows[slot] != sourceRow) {
+                const Pixel *row = imageRow(src, sourceRow);
+                routines.horizontalPass(size, row, kernel->rowWeights, filtered, interiorStart, interiorStop);
+                for (int colIndex = job->firstCol; colIndex < job->lastCol; colIndex++) {
+                    if (colIndex == interiorStart) colIndex = interiorStop;
+                    if (colIndex >= job->lastCol) break;
+                    filtered[colIndex] = clampedRowSum(row, kernel->rowWeights, size, colIndex, width);
+                }
+                ringRows[slot] = sourceRow;
+            }
+            rows[i] = filtered;
+        }
+        for (int i = 0; i < size; i++) rows[i] += job->firstCol;
+        routines.verticalPass(size, rows, kernel->columnWeights, kernel->separableDivisor,
+                              imageRow(job->dst, rowIndex) + job->firstCol, job->lastCol - job->firstCol);
+    }
+    if (ownRing) free(ring);
+    return true;
+}
+
+static void convolveBand(void *context, int bandIndex) {
+    ConvolutionJob *job = (ConvolutionJob *)context;
+    int height = job->src->height;
+    int firstRow = (int)((long long)height * bandIndex / job->bandCount);
+    int lastRow = (int)((long long)height * (bandIndex + 1) / job->bandCount);
+
+    if (!job->kernel->separable) convolveDirectRows(job, firstRow, lastRow);
+    else if (!convolveSeparableRows(job, firstRow, lastRow)) atomic_store(&job->failed, true);
+}
+
+// Out-of-place convolution; dst must match src in size. The bands take
+// their rings from workspace unless it is NULL.
+bool convolveImage(const SonarImage *src, SonarImage *dst, const ConvolutionKernel *kernel,
+                   FilterWorkspace *workspace) {
+    ConvolutionJob job = {src, dst, kernel, chooseBandCount(src->height, src->width), false, 0, src->width,
+                          workspace};
+    parallelFor(job.bandCount, convolveBand, &job);
+    return !atomic_load(&job.failed);
+}
+
+// Convolve only the rectangle [x0,x1)×[y0,y1) of dst, on the calling
+// thread; borders still clamp to the edges of the whole frame
+bool convolveRegion(const SonarImage *src, SonarImage *dst, const ConvolutionKernel *kernel,
+                    int x0, int y0, int x1, int y1, FilterWorkspace *workspace) {
+    ConvolutionJob job = {src, dst, kernel, 1, false, x0, x1, workspace};
+    if (!kernel->separable) {
+        convolveDirectRows(&job, y0, y1);
+        return true;
+    }
+    return convolveSeparableRows(&job, y0, y1);
+}
+
+// Rotate by the requested angle: in place for square frames, otherwise
+// into a new buffer that replaces the old one
+bool rotateFrame(SonarImage *image, int degrees) {
+    if (image->width == image->height) return rotateImageInPlace(image, degrees);
+
+    SonarImage rotated;
+    bool quarterTurn = degrees != 180;
+    if (!createImage(&rotated, quarterTurn ? image->height : image->width,
+                     quarterTurn ? image->width : image->height)) {
+        printf("Memory allocation failed for rotated matrix!\n");
+        return false;
+    }
+    rotateImage(image, &rotated, degrees);
+    freeImage(image);
+    *image = rotated;
+    return true;
+}
+
+void showMatrix(const char *title, const SonarImage *image) {
+    printf("\n%s:\n", title);
+    if (image->width <= MAX_PRINT_SIZE && image->height <= MAX_PRINT_SIZE) printMatrix(image);
+    else printf("(%d×%d frame not printed)\n", image->width, image->height);
+}
+
+// Frame files: raw native-endian pixels (dimensions from --size) or binary
+// PGM (P5 with 8- or 16-bit big-endian samples; several images may be
+// concatenated). Regular files are mapped, and frames whose bytes already
+// match the in-memory Pixel layout are used in place; anything else
+// (pipes, rescaled or byte-swapped samples) is decoded into a buffer.
+typedef struct {
+    int fd;
+    FILE *stream;               // fallback when the input cannot be mapped
+    const unsigned char *data;  // the mapping, NULL for streams
+    size_t size;
+    size_t offset;              // start of the next frame
+    bool pgm;
+    int width, height;
+} FrameFile;
+
+static inline bool hostIsBigEndian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe == 0;
+}
+
+static bool pathIsPgm(const char *path) {
+    size_t length = strlen(path);
+    return length >= 4 && (strcmp(path + length - 4, ".pgm") == 0 || strcmp(path + length - 4, ".PGM") == 0);
+}
+
+// Parse the P5 header at *offset and move past it to the first sample
+static bool parsePgmHeader(const unsigned char *data, size_t size, size_t *offset,
+                           int *width, int *height, int *maxValue) {
+    size_t position = *offset;
+    long fields[3];
+
+    if (position + 2 > size || data[position] != 'P' || data[position + 1] != '5') return false;
+    position += 2;
+
+    for (int field = 0; field < 3; field++) {
+        while (position < size && (isspace(data[position]) || data[position] == '#')) {
+            if (data[position] == '#') {
+                while (position < size && data[position] != '\n') position++;
+            }
+            else position++;
+        }
+        if (position >= size || !isdigit(data[position])) return false;
+
+        long value = 0;
+        while (position < size && isdigit(data[position]) && value <= 1000000) {
+            value = value * 10 + (data[position++] - '0');
+        }
+        fields[field] = value;
+    }
+    // exactly one whitespace byte separates the header from the samples
+    if (position >= size || !isspace(data[position])) return false;
+
+    if (fields[0] < 2 || fields[0] > MAX_MATRIX_SIZE || fields[1] < 2 || fields[1] > MAX_MATRIX_SIZE ||
+        fields[2] < 1 || fields[2] > 65535) {
+        return false;
+    }
+    *width = (int)fields[0];
+    *height = (int)fields[1];
+    *maxValue = (int)fields[2];
+    *offset = position + 1;
+    return true;
+}
+
+void closeFrameFile(FrameFile *file) {
+    if (file->data != NULL) munmap((void *)file->data, file->size);
+    if (file->stream != NULL) fclose(file->stream);
+    else if (file->fd >= 0) close(file->fd);
+    file->data = NULL;
+    file->stream = NULL;
+    file->fd = -1;
+}
+
+// Open a frame file; width and height are required for raw input (0 if
+// unknown) and ignored for PGM, whose header supplies them
+bool openFrameFile(FrameFile *file, const char *path, int width, int height) {
+    memset(file, 0, sizeof(*file));
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0) {
+        printf("Could not open %s\n", path);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(file->fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        void *mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+        if (mapping != MAP_FAILED) {
+            file->data = (const unsigned char *)mapping;
+            file->size = (size_t)info.st_size;
+            posix_madvise(mapping, file->size, POSIX_MADV_SEQUENTIAL);
+        }
+    }
+    if (file->data == NULL) {
+        file->stream = fdopen(file->fd, "rb");
+        if (file->stream == NULL) {
+            printf("Could not open %s\n", path);
+            closeFrameFile(file);
+            return false;
+        }
+    }
+
+    file->pgm = file->data != NULL && file->size >= 2 && file->data[0] == 'P' && file->data[1] == '5';
+    if (file->pgm) {
+        size_t offset = 0;
+        int maxValue;
+        if (!parsePgmHeader(file->data, file->size, &offset, &file->width, &file->height, &maxValue)) {
+            printf("%s is not a valid binary PGM file.\n", path);
+            closeFrameFile(file);
+            return false;
+        }
+    }
+    else if (width == 0) {
+        printf("Raw input needs the frame size, e.g. --size 1024x768\n");
+        closeFrameFile(file);
+        return false;
+    }
+    else {
+        file->width = width;
+        file->height = height;
+    }
+    return true;
+}
+
+static bool readFrame(FILE *input, SonarImage *image) {
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        if (fread(imageRow(image, rowIndex), sizeof(Pixel), image->width, input) != (size_t)image->width) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Fetch the next frame into *frame: a view onto the mapped pages when the
+// layout matches, otherwise decoded into `buffer` (sized like the file's
+// frames). Returns false at the end of the file or on a truncated frame.
+bool nextFrame(FrameFile *file, SonarImage *frame, SonarImage *buffer) {
+    if (file->stream != NULL) {
+        if (!readFrame(file->stream, buffer)) return false;
+        *frame = *buffer;
+        return true;
+    }
+
+    size_t offset = file->offset;
+    int maxValue = PIXEL_MAX;
+    size_t sampleBytes = sizeof(Pixel);
+    if (file->pgm) {
+        int width, height;
+        while (offset < file->size && isspace(file->data[offset])) offset++;
+        if (offset >= file->size) return false;
+        if (!parsePgmHeader(file->data, file->size, &offset, &width, &height, &maxValue) ||
+            width != file->width || height != file->height) {
+            printf("Malformed or differently sized PGM frame at byte %zu\n", offset);
+            return false;
+        }
+        sampleBytes = maxValue > 255 ? 2 : 1;
+    }
+
+    size_t frameBytes = (size_t)file->width * file->height * sampleBytes;
+    if (offset + frameBytes > file->size) {
+        if (offset < file->size) printf("Ignoring a truncated frame at byte %zu\n", offset);
+        return false;
+    }
+    const unsigned char *samples = file->data + offset;
+    file->offset = offset + frameBytes;
+
+    bool inPlace = sampleBytes == sizeof(Pixel) && maxValue == PIXEL_MAX &&
+                   (uintptr_t)samples % sizeof(Pixel) == 0 &&
+                   (!file->pgm || sizeof(Pixel) == 1 || hostIsBigEndian());
+    if (inPlace) {
+        frame->width = file->width;
+        frame->height = file->height;
+        frame->stride = file->width;
+        frame->pixels = (Pixel *)samples;
+        return true;
+    }
+
+    for (int rowIndex = 0; rowIndex < file->height; rowIndex++) {
+        const unsigned char *row = samples + (size_t)rowIndex * file->width * sampleBytes;
+        Pixel *target = imageRow(buffer, rowIndex);
+
+        if (!file->pgm) {
+            memcpy(target, row, file->width * sizeof(Pixel));
+            continue;
+        }
+        for (int colIndex = 0; colIndex < file->width; colIndex++) {
+            uint32_t value = sampleBytes == 2 ? (uint32_t)row[2 * colIndex] << 8 | row[2 * colIndex + 1]
+                                              : row[colIndex];
+            if (value > (uint32_t)maxValue) value = maxValue;
+            target[colIndex] = (Pixel)((value * (uint64_t)PIXEL_MAX + maxValue / 2) / maxValue);
+        }
+    }
+    *frame = *buffer;
+    return true;
+}
+
+// Copy a frame (for example a view onto a mapping) into its own buffer
+bool loadFrameCopy(FrameFile *file, SonarImage *image) {
+    SonarImage frame;
+    if (!createImage(image, file->width, file->height)) {
+        printf("Memory allocation failed for matrix!\n");
+        return false;
+    }
+    if (!nextFrame(file, &frame, image)) {
+        printf("The input holds no complete frame.\n");
+        freeImage(image);
+        return false;
+    }
+    if (frame.pixels != image->pixels) {
+        for (int rowIndex = 0; rowIndex < frame.height; rowIndex++) {
+            memcpy(imageRow(image, rowIndex), imageRow(&frame, rowIndex), frame.width * sizeof(Pixel));
+        }
+    }
+    return true;
+}
+
+static int formatPgmHeader(char *header, size_t size, const SonarImage *image) {
+    return snprintf(header, size, "P5\n%d %d\n%d\n", image->width, image->height, PIXEL_MAX);
+}
+
+// PGM samples are big-endian
+static void storePgmSamples(unsigned char *out, const Pixel *row, int width) {
+#if SONAR_PIXEL_BITS == 16
+    for (int colIndex = 0; colIndex < width; colIndex++) {
+        out[2 * colIndex] = (unsigned char)(row[colIndex] >> 8);
+        out[2 * colIndex + 1] = (unsigned char)row[colIndex];
+    }
+#else
+    memcpy(out, row, width);
+#endif
+}
+
+// Append one frame to a stream, as raw pixels or as a PGM image
+static bool writeFrame(FILE *output, const SonarImage *image, bool pgm) {
+    if (!pgm) {
+        for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+            if (fwrite(imageRow(image, rowIndex), sizeof(Pixel), image->width, output) != (size_t)image->width) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    char header[64];
+    int headerLength = formatPgmHeader(header, sizeof(header), image);
+    if (fwrite(header, 1, headerLength, output) != (size_t)headerLength) return false;
+
+    unsigned char chunk[4096];
+    int chunkPixels = (int)(sizeof(chunk) / sizeof(Pixel));
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        const Pixel *row = imageRow(image, rowIndex);
+        for (int colIndex = 0; colIndex < image->width; colIndex += chunkPixels) {
+            int count = image->width - colIndex < chunkPixels ? image->width - colIndex : chunkPixels;
+            storePgmSamples(chunk, row + colIndex, count);
+            if (fwrite(chunk, sizeof(Pixel), count, output) != (size_t)count) return false;
+        }
+    }
+    return true;
+}
+
+// Save one frame through a shared mapping of the output file; the format
+// follows the extension (.pgm, otherwise raw pixels)
+bool writeImageFile(const char *path, const SonarImage *image) {
+    bool pgm = pathIsPgm(path);
+    char header[64];
+    size_t headerLength = pgm ? (size_t)formatPgmHeader(header, sizeof(header), image) : 0;
+    size_t rowBytes = (size_t)image->width * sizeof(Pixel);
+    size_t fileSize = headerLength + rowBytes * image->height;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)fileSize) != 0) {
+        close(fd);
+        return false;
+    }
+    unsigned char *mapping = (unsigned char *)mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    memcpy(mapping, header, headerLength);
+    for (int rowIndex = 0; rowIndex < image->height; rowIndex++) {
+        unsigned char *target = mapping + headerLength + rowIndex * rowBytes;
+        if (pgm) storePgmSamples(target, imageRow(image, rowIndex), image->width);
+        else memcpy(target, imageRow(image, rowIndex), rowBytes);
+    }
+
+    bool written = munmap(mapping, fileSize) == 0;
+    return close(fd) == 0 && written;
+}
+
+// Connected-component labeling of the thresholded frame. Tiles are
+// labeled independently (in parallel) with a local union-find; their
+// components are then merged across tile borders with 8-connectivity.
+typedef struct {
+    int area;
+    long long sumRow;
+    long long sumCol;
+    int minRow, minCol, maxRow, maxCol;
+} BlobStats;
+
+typedef struct {
+    int componentCount;
+    int componentCapacity;
+    BlobStats *components;
+    int globalBase;           // first merge id of this tile's components
+} LabelTile;
+
+typedef struct {
+    int area;
+    double centroidRow;
+    double centroidCol;
+    int minRow, minCol, maxRow, maxCol;
+    int trackId;
+    double meanIntensity;     // over the bounding box
+    double surroundMean;      // over a BLOB_SURROUND_MARGIN ring around it
+} Blob;
+
+typedef struct {
+    const SonarImage *image;
+    int threshold;
+    int width, height;
+    int tilesAcross, tilesDown;
+    int *labels;              // per pixel: component index within its tile, -1 for background
+    LabelTile *tiles;
+    int mergeCapacity;
+    int *mergeParent;
+    BlobStats *mergedStats;
+    SummedAreaTable *tileSums;  // one per tile, rebuilt with its labels, for the blobs' rectangle means
+    const uint8_t *dirtyTiles;  // tiles to re-label; NULL re-labels all
+    atomic_bool failed;
+} BlobLabeler;
+
+static inline int findLabel(int *parent, int label) {
+    while (parent[label] != label) {
+        parent[label] = parent[parent[label]];
+        label = parent[label];
+    }
+    return label;
+}
+
+// union by smaller index keeps roots at the first-seen label
+static inline int unionLabels(int *parent, int a, int b) {
+    a = findLabel(parent, a);
+    b = findLabel(parent, b);
+    if (a < b) parent[b] = a;
+    else parent[a] = b;
+    return a < b ? a : b;
+}
+
+static void addPixelToStats(BlobStats *stats, int rowIndex, int colIndex) {
+    if (stats->area == 0) {
+        stats->minRow = stats->maxRow = rowIndex;
+        stats->minCol = stats->maxCol = colIndex;
+    }
+    stats->area++;
+    stats->sumRow += rowIndex;
+    stats->sumCol += colIndex;
+    if (rowIndex < stats->minRow) stats->minRow = rowIndex;
+    if (rowIndex > stats->maxRow) stats->maxRow = rowIndex;
+    if (colIndex < stats->minCol) stats->minCol = colIndex;
+    if (colIndex > stats->maxCol) stats->maxCol = colIndex;
+}
+
+static void mergeStats(BlobStats *into, const BlobStats *from) {
+    if (from->area == 0) return;
+    if (into->area == 0) {
+        *into = *from;
+        return;
+    }
+    into->area += from->area;
+    into->sumRow += from->sumRow;
+    into->sumCol += from->sumCol;
+    if (from->minRow < into->minRow) into->minRow = from->minRow;
+    if (from->maxRow > into->maxRow) into->maxRow = from->maxRow;
+    if (from->minCol < into->minCol) into->minCol = from->minCol;
+    if (from->maxCol > into->maxCol) into->maxCol = from->maxCol;
+}
+
+void freeBlobLabeler(BlobLabeler *labeler) {
+    if (labeler->tiles != NULL) {
+        for (int tileIndex = 0; tileIndex < labeler->tilesAcross * labeler->tilesDown; tileIndex++) {
+            free(labeler->tiles[tileIndex].components);
+        }
+    }
+    free(labeler->tiles);
+    free(labeler->labels);
+    free(labeler->mergeParent);
+    free(labeler->mergedStats);
+    if (labeler->tileSums != NULL) {
+        for (int tileIndex = 0; tileIndex < labeler->tilesAcross * labeler->tilesDown; tileIndex++) {
+            freeSummedAreaTable(&labeler->tileSums[tileIndex]);
+        }
+    }
+    free(labeler->tileSums);
+    memset(labeler, 0, sizeof(*labeler));
+}
+
+bool initBlobLabeler(BlobLabeler *labeler, int width, int height, int threshold) {
+    memset(labeler, 0, sizeof(*labeler));
+    labeler->threshold = threshold;
+    labeler->width = width;
+    labeler->height = height;
+    labeler->tilesAcross = (width + LABEL_TILE - 1) / LABEL_TILE;
+    labeler->tilesDown = (height + LABEL_TILE - 1) / LABEL_TILE;
+    labeler->labels = (int *)malloc((size_t)width * height * sizeof(int));
+    labeler->tiles = (LabelTile *)calloc((size_t)labeler->tilesAcross * labeler->tilesDown, sizeof(LabelTile));
+    labeler->tileSums = (SummedAreaTable *)calloc((size_t)labeler->tilesAcross * labeler->tilesDown,
+                                                  sizeof(SummedAreaTable));
+    if (labeler->labels == NULL || labeler->tiles == NULL || labeler->tileSums == NULL) {
+        freeBlobLabeler(labeler);
+        return false;
+    }
+    for (int tileIndex = 0; tileIndex < labeler->tilesAcross * labeler->tilesDown; tileIndex++) {
+        int firstRow = tileIndex / labeler->tilesAcross * LABEL_TILE;
+        int firstCol = tileIndex % labeler->tilesAcross * LABEL_TILE;
+        if (!initSummedAreaTable(&labeler->tileSums[tileIndex],
+                                 width - firstCol < LABEL_TILE ? width - firstCol : LABEL_TILE,
+                                 height - firstRow < LABEL_TILE ? height - firstRow : LABEL_TILE)) {
+            freeBlobLabeler(labeler);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void labelTile(void *context, int tileIndex) {
+    BlobLabeler *labeler = (BlobLabeler *)context;
+    if (labeler->dirtyTiles != NULL && !labeler->dirtyTiles[tileIndex]) return;
+
+    LabelTile *tile = &labeler->tiles[tileIndex];
+    int width = labeler->width;
+    int firstRow = tileIndex / labeler->tilesAcross * LABEL_TILE;
+    int firstCol = tileIndex % labeler->tilesAcross * LABEL_TILE;
+    int lastRow = firstRow + LABEL_TILE < labeler->height ? firstRow + LABEL_TILE : labeler->height;
+    int lastCol = firstCol + LABEL_TILE < width ? firstCol + LABEL_TILE : width;
+    int parent[LABEL_TILE * LABEL_TILE];
+    int compact[LABEL_TILE * LABEL_TILE];
+    int provisionalCount = 0;
+
+    SonarImage tilePixels = *labeler->image;
+    tilePixels.width = lastCol - firstCol;
+    tilePixels.height = lastRow - firstRow;
+    tilePixels.pixels = imageRow(labeler->image, firstRow) + firstCol;
+    buildSummedAreaTable(&labeler->tileSums[tileIndex], &tilePixels);
+
+    // pass 1: provisional labels from the already visited W, NW, N and NE neighbours
+    for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+        const Pixel *row = imageRow(labeler->image, rowIndex);
+        int *labelRow = labeler->labels + (size_t)rowIndex * width;
+
+        for (int colIndex = firstCol; colIndex < lastCol; colIndex++) {
+            if (row[colIndex] < labeler->threshold) {
+                labelRow[colIndex] = -1;
+                continue;
+            }
+
+            int label = -1;
+            if (colIndex > firstCol && labelRow[colIndex - 1] >= 0) label = findLabel(parent, labelRow[colIndex - 1]);
+            if (rowIndex > firstRow) {
+                const int *aboveRow = labelRow - width;
+                for (int neighborCol = colIndex - 1; neighborCol <= colIndex + 1; neighborCol++) {
+                    if (neighborCol < firstCol || neighborCol >= lastCol || aboveRow[neighborCol] < 0) continue;
+                    label = label < 0 ? findLabel(parent, aboveRow[neighborCol])
+                                      : unionLabels(parent, label, aboveRow[neighborCol]);
+                }
+            }
+            if (label < 0) {
+                label = provisionalCount;
+                parent[provisionalCount++] = label;
+            }
+            labelRow[colIndex] = label;
+        }
+    }
+
+    // number the roots 0..k-1
+    int componentCount = 0;
+    for (int label = 0; label < provisionalCount; label++) {
+        if (findLabel(parent, label) == label) compact[label] = componentCount++;
+    }
+
+    if (componentCount > tile->componentCapacity) {
+        BlobStats *grown = (BlobStats *)realloc(tile->components, componentCount * sizeof(BlobStats));
+        if (grown == NULL) {
+            atomic_store(&labeler->failed, true);
+            tile->componentCount = 0;
+            return;
+        }
+        tile->components = grown;
+        tile->componentCapacity = componentCount;
+    }
+    tile->componentCount = componentCount;
+    if (componentCount > 0) memset(tile->components, 0, componentCount * sizeof(BlobStats));
+
+    // pass 2: final tile-local labels and per-component statistics
+    for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+        int *labelRow = labeler->labels + (size_t)rowIndex * width;
+        for (int colIndex = firstCol; colIndex < lastCol; colIndex++) {
+            if (labelRow[colIndex] < 0) continue;
+            int component = compact[findLabel(parent, labelRow[colIndex])];
+            labelRow[colIndex] = component;
+            addPixelToStats(&tile->components[component], rowIndex, colIndex);
+        }
+    }
+}
+
+static inline int mergeIdAt(const BlobLabeler *labeler, int rowIndex, int colIndex) {
+    int label = labeler->labels[(size_t)rowIndex * labeler->width + colIndex];
+    if (label < 0) return -1;
+    int tileIndex = rowIndex / LABEL_TILE * labeler->tilesAcross + colIndex / LABEL_TILE;
+    return labeler->tiles[tileIndex].globalBase + label;
+}
+
+// union the components touching across the right and bottom edges of each tile
+static void mergeTileBorders(BlobLabeler *labeler) {
+    int *parent = labeler->mergeParent;
+
+    for (int tileRow = 0; tileRow < labeler->tilesDown; tileRow++) {
+        for (int tileCol = 0; tileCol < labeler->tilesAcross; tileCol++) {
+            int firstRow = tileRow * LABEL_TILE, firstCol = tileCol * LABEL_TILE;
+            int lastRow = firstRow + LABEL_TILE < labeler->height ? firstRow + LABEL_TILE : labeler->height;
+            int lastCol = firstCol + LABEL_TILE < labeler->width ? firstCol + LABEL_TILE : labeler->width;
+
+            if (lastCol < labeler->width) {
+                for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+                    int left = mergeIdAt(labeler, rowIndex, lastCol - 1);
+                    if (left < 0) continue;
+                    for (int neighborRow = rowIndex - 1; neighborRow <= rowIndex + 1; neighborRow++) {
+                        if (neighborRow < 0 || neighborRow >= labeler->height) continue;
+                        int right = mergeIdAt(labeler, neighborRow, lastCol);
+                        if (right >= 0) unionLabels(parent, left, right);
+                    }
+                }
+            }
+            if (lastRow < labeler->height) {
+                for (int colIndex = firstCol; colIndex < lastCol; colIndex++) {
+                    int upper = mergeIdAt(labeler, lastRow - 1, colIndex);
+                    if (upper < 0) continue;
+                    for (int neighborCol = colIndex - 1; neighborCol <= colIndex + 1; neighborCol++) {
+                        if (neighborCol < 0 || neighborCol >= labeler->width) continue;
+                        int lower = mergeIdAt(labeler, lastRow, neighborCol);
+                        if (lower >= 0) unionLabels(parent, upper, lower);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Sum over columns [x0, x1) and rows [y0, y1), from the tiles it overlaps
+static uint64_t tiledRectangleSum(const BlobLabeler *labeler, int x0, int y0, int x1, int y1) {
+    uint64_t sum = 0;
+    for (int tileRow = y0 / LABEL_TILE; tileRow <= (y1 - 1) / LABEL_TILE; tileRow++) {
+        int top = tileRow * LABEL_TILE;
+        for (int tileCol = x0 / LABEL_TILE; tileCol <= (x1 - 1) / LABEL_TILE; tileCol++) {
+            int left = tileCol * LABEL_TILE;
+            const SummedAreaTable *table = &labeler->tileSums[tileRow * labeler->tilesAcross + tileCol];
+            sum += rectangleSum(table, (x0 > left ? x0 : left) - left, (y0 > top ? y0 : top) - top,
+                                (x1 < left + table->width ? x1 : left + table->width) - left,
+                                (y1 < top + table->height ? y1 : top + table->height) - top);
+        }
+    }
+    return sum;
+}
+
+static int compareBlobArea(const void *a, const void *b) {
+    return ((const Blob *)b)->area - ((const Blob *)a)->area;
+}
+
+// Label pixels >= threshold and return up to maxBlobs blobs of at least
+// minArea pixels, largest first; -1 on allocation failure. With dirtyTiles,
+// only those label tiles are re-labeled and the rest keep their labels and
+// pixel sums from the previous call, whose image must match them there.
+int findBlobs(BlobLabeler *labeler, const SonarImage *image, const uint8_t *dirtyTiles,
+              int minArea, Blob *blobs, int maxBlobs) {
+    labeler->image = image;
+    labeler->dirtyTiles = dirtyTiles;
+    atomic_store(&labeler->failed, false);
+
+    int tileCount = labeler->tilesAcross * labeler->tilesDown;
+    parallelFor(tileCount, labelTile, labeler);
+    if (atomic_load(&labeler->failed)) return -1;
+
+    int componentTotal = 0;
+    for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+        labeler->tiles[tileIndex].globalBase = componentTotal;
+        componentTotal += labeler->tiles[tileIndex].componentCount;
+    }
+
+    if (componentTotal > labeler->mergeCapacity) {
+        int capacity = labeler->mergeCapacity > 0 ? labeler->mergeCapacity : 1024;
+        while (capacity < componentTotal) capacity *= 2;
+        int *parent = (int *)realloc(labeler->mergeParent, capacity * sizeof(int));
+        if (parent != NULL) labeler->mergeParent = parent;
+        BlobStats *stats = (BlobStats *)realloc(labeler->mergedStats, capacity * sizeof(BlobStats));
+        if (stats != NULL) labeler->mergedStats = stats;
+        if (parent == NULL || stats == NULL) return -1;
+        labeler->mergeCapacity = capacity;
+    }
+
+    for (int id = 0; id < componentTotal; id++) labeler->mergeParent[id] = id;
+    mergeTileBorders(labeler);
+
+    if (componentTotal > 0) memset(labeler->mergedStats, 0, componentTotal * sizeof(BlobStats));
+    for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+        const LabelTile *tile = &labeler->tiles[tileIndex];
+        for (int component = 0; component < tile->componentCount; component++) {
+            int root = findLabel(labeler->mergeParent, tile->globalBase + component);
+            mergeStats(&labeler->mergedStats[root], &tile->components[component]);
+        }
+    }
+
+    // keep the largest blobs: fill, then replace the smallest once full
+    int blobCount = 0;
+    for (int id = 0; id < componentTotal; id++) {
+        const BlobStats *stats = &labeler->mergedStats[id];
+        if (labeler->mergeParent[id] != id || stats->area < minArea) continue;
+
+        Blob blob = {stats->area, (double)stats->sumRow / stats->area, (double)stats->sumCol / stats->area,
+                     stats->minRow, stats->minCol, stats->maxRow, stats->maxCol, -1, 0, 0};
+        if (blobCount < maxBlobs) {
+            blobs[blobCount++] = blob;
+            if (blobCount == maxBlobs) qsort(blobs, blobCount, sizeof(Blob), compareBlobArea);
+        }
+        else if (blob.area > blobs[maxBlobs - 1].area) {
+            int position = maxBlobs - 1;
+            while (position > 0 && blobs[position - 1].area < blob.area) {
+                blobs[position] = blobs[position - 1];
+                position--;
+            }
+            blobs[position] = blob;
+        }
+    }
+    if (blobCount < maxBlobs) qsort(blobs, blobCount, sizeof(Blob), compareBlobArea);
+
+    // contrast against the surroundings: the ring is the grown box minus the box
+    for (int b = 0; b < blobCount; b++) {
+        Blob *blob = &blobs[b];
+        int x0 = blob->minCol, y0 = blob->minRow, x1 = blob->maxCol + 1, y1 = blob->maxRow + 1;
+        int grownX0 = x0 - BLOB_SURROUND_MARGIN > 0 ? x0 - BLOB_SURROUND_MARGIN : 0;
+        int grownY0 = y0 - BLOB_SURROUND_MARGIN > 0 ? y0 - BLOB_SURROUND_MARGIN : 0;
+        int grownX1 = x1 + BLOB_SURROUND_MARGIN < labeler->width ? x1 + BLOB_SURROUND_MARGIN : labeler->width;
+        int grownY1 = y1 + BLOB_SURROUND_MARGIN < labeler->height ? y1 + BLOB_SURROUND_MARGIN : labeler->height;
+
+        uint64_t boxSum = tiledRectangleSum(labeler, x0, y0, x1, y1);
+        uint64_t ringSum = tiledRectangleSum(labeler, grownX0, grownY0, grownX1, grownY1) - boxSum;
+        int64_t ringArea = (int64_t)(grownX1 - grownX0) * (grownY1 - grownY0) - (int64_t)(x1 - x0) * (y1 - y0);
+
+        blob->meanIntensity = (double)boxSum / ((double)(x1 - x0) * (y1 - y0));
+        blob->surroundMean = ringArea > 0 ? (double)ringSum / ringArea : 0;
+    }
+    return blobCount;
+}
+
+// Frame-to-frame association: each live track predicts its next centroid
+// from its last velocity and claims the nearest unclaimed blob within
+// maxDistance, closest pairs first. Unclaimed blobs start new tracks.
+typedef struct {
+    int id;
+    double row, col;
+    double velocityRow, velocityCol;
+    int age;
+    int missed;
+} Track;
+
+typedef struct {
+    Track tracks[MAX_TRACKS];
+    int trackCount;
+    int nextId;
+    double maxDistance;
+} Tracker;
+
+typedef struct {
+    double distanceSquared;
+    int trackIndex;
+    int blobIndex;
+} TrackCandidate;
+
+static int compareCandidates(const void *a, const void *b) {
+    double da = ((const TrackCandidate *)a)->distanceSquared;
+    double db = ((const TrackCandidate *)b)->distanceSquared;
+    return (da > db) - (da < db);
+}
+
+void initTracker(Tracker *tracker, double maxDistance) {
+    tracker->trackCount = 0;
+    tracker->nextId = 1;
+    tracker->maxDistance = maxDistance;
+}
+
+void updateTracks(Tracker *tracker, Blob *blobs, int blobCount) {
+    static TrackCandidate candidates[MAX_TRACKS * MAX_BLOBS_PER_FRAME];
+    bool trackClaimed[MAX_TRACKS] = {false};
+    int candidateCount = 0;
+    double limit = tracker->maxDistance * tracker->maxDistance;
+
+    for (int t = 0; t < tracker->trackCount; t++) {
+        const Track *track = &tracker->tracks[t];
+        double predictedRow = track->row + track->velocityRow;
+        double predictedCol = track->col + track->velocityCol;
+        for (int b = 0; b < blobCount; b++) {
+            double dRow = blobs[b].centroidRow - predictedRow;
+            double dCol = blobs[b].centroidCol - predictedCol;
+            double distanceSquared = dRow * dRow + dCol * dCol;
+            if (distanceSquared <= limit) {
+                candidates[candidateCount++] = (TrackCandidate){distanceSquared, t, b};
+            }
+        }
+    }
+    qsort(candidates, candidateCount, sizeof(TrackCandidate), compareCandidates);
+
+    for (int b = 0; b < blobCount; b++) blobs[b].trackId = -1;
+    for (int c = 0; c < candidateCount; c++) {
+        Track *track = &tracker->tracks[candidates[c].trackIndex];
+        Blob *blob = &blobs[candidates[c].blobIndex];
+        if (trackClaimed[candidates[c].trackIndex] || blob->trackId != -1) continue;
+
+        trackClaimed[candidates[c].trackIndex] = true;
+        blob->trackId = track->id;
+        track->velocityRow = blob->centroidRow - track->row;
+        track->velocityCol = blob->centroidCol - track->col;
+        track->row = blob->centroidRow;
+        track->col = blob->centroidCol;
+        track->age++;
+        track->missed = 0;
+    }
+
+    // age out unmatched tracks, compacting the array in place
+    int kept = 0;
+    for (int t = 0; t < tracker->trackCount; t++) {
+        Track *track = &tracker->tracks[t];
+        if (!trackClaimed[t] && ++track->missed > TRACK_MAX_MISSED) continue;
+        tracker->tracks[kept++] = *track;
+    }
+    tracker->trackCount = kept;
+
+    for (int b = 0; b < blobCount && tracker->trackCount < MAX_TRACKS; b++) {
+        if (blobs[b].trackId != -1) continue;
+        Track *track = &tracker->tracks[tracker->trackCount++];
+        track->id = tracker->nextId++;
+        track->row = blobs[b].centroidRow;
+        track->col = blobs[b].centroidCol;
+        track->velocityRow = track->velocityCol = 0;
+        track->age = 1;
+        track->missed = 0;
+        blobs[b].trackId = track->id;
+    }
+}
+
+void printBlob(const Blob *blob) {
+    printf("  object %d: area %d, centroid (%.1f, %.1f), box (%d,%d)-(%d,%d), mean %.1f vs %.1f around\n",
+           blob->trackId, blob->area, blob->centroidRow, blob->centroidCol, blob->minRow, blob->minCol,
+           blob->maxRow, blob->maxCol, blob->meanIntensity, blob->surroundMean);
+}
+
+double monotonicMilliseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// Incremental reprocessing of mostly static scenes. The transform stage
+// keeps the previous input and its smoothed (unrotated) result. Each new
+// frame is diffed in CHANGE_TILE tiles; only tiles within the filter halo
+// of a change are smoothed again, and only the label tiles the change can
+// reach are marked for re-labeling. Busy frames fall back to a full pass.
+//
+// Frame slots are recycled, so a slot's rotated and convolved buffers hold
+// the frame it carried a few frames ago. Every tile remembers the frame in
+// which its smoothed and its final pixels last changed; a slot is brought
+// up to date by re-rotating and re-convolving just the tiles that changed
+// since the frame it holds.
+typedef struct {
+    bool primed;                  // reference and smoothed hold a frame
+    int tilesAcross, tilesDown;   // CHANGE_TILE grid over the input
+    SonarImage reference;         // last input frame
+    SonarImage smoothed;          // its smoothed result, unrotated
+    uint8_t *changed;             // tiles that differ from the reference
+    uint8_t *resmooth;            // tiles whose smoothed pixels are recomputed
+    uint8_t *reach;               // tiles whose final pixels may change
+    uint8_t *scratch;
+    long serial;                  // frames applied so far
+    long *smoothedAt;             // per tile: serial of the last change to its smoothed pixels
+    long *reachedAt;              // per tile: serial of the last change that can reach its final pixels
+    const SonarImage *input;      // frame being applied, for the workers
+    int radius;
+    int degrees;
+    SonarImage *output;           // frame slot being synced, for the workers
+    SonarImage *filtered;
+    const ConvolutionKernel *kernel;
+    long since;                   // serial the slot held before syncing
+    FilterWorkspace *filters;     // the caller's, for the per-tile kernels
+    atomic_bool failed;
+    long tilesRedone;             // totals for the summary
+    long tilesSeen;
+    long tilesSynced;
+} ChangeTracker;
+
+void freeChangeTracker(ChangeTracker *tracker) {
+    freeImage(&tracker->reference);
+    freeImage(&tracker->smoothed);
+    free(tracker->changed);
+    free(tracker->resmooth);
+    free(tracker->reach);
+    free(tracker->scratch);
+    free(tracker->smoothedAt);
+    free(tracker->reachedAt);
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+// filters supplies the kernels' scratch buffers and must outlive the tracker
+bool initChangeTracker(ChangeTracker *tracker, int width, int height, FilterWorkspace *filters) {
+    memset(tracker, 0, sizeof(*tracker));
+    tracker->filters = filters;
+    tracker->tilesAcross = (width + CHANGE_TILE - 1) / CHANGE_TILE;
+    tracker->tilesDown = (height + CHANGE_TILE - 1) / CHANGE_TILE;
+    size_t tileCount = (size_t)tracker->tilesAcross * tracker->tilesDown;
+    tracker->changed = (uint8_t *)malloc(tileCount);
+    tracker->resmooth = (uint8_t *)malloc(tileCount);
+    tracker->reach = (uint8_t *)malloc(tileCount);
+    tracker->scratch = (uint8_t *)malloc(tileCount);
+    tracker->smoothedAt = (long *)calloc(tileCount, sizeof(long));
+    tracker->reachedAt = (long *)calloc(tileCount, sizeof(long));
+    if (!createImage(&tracker->reference, width, height) || !createImage(&tracker->smoothed, width, height) ||
+        tracker->changed == NULL || tracker->resmooth == NULL || tracker->reach == NULL || tracker->scratch == NULL ||
+        tracker->smoothedAt == NULL || tracker->reachedAt == NULL) {
+        freeChangeTracker(tracker);
+        return false;
+    }
+    return true;
+}
+
+static bool rowsDiffer(const Pixel *a, const Pixel *b, int count) {
+    const unsigned char *left = (const unsigned char *)a, *right = (const unsigned char *)b;
+    size_t bytes = (size_t)count * sizeof(Pixel), offset = 0;
+#if defined(__SSE2__)
+    for (; offset + 16 <= bytes; offset += 16) {
+        __m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(left + offset)),
+                                       _mm_loadu_si128((const __m128i *)(right + offset)));
+        if (_mm_movemask_epi8(equal) != 0xFFFF) return true;
+    }
+#endif
+    return memcmp(left + offset, right + offset, bytes - offset) != 0;
+}
+
+// Diff one row of tiles against the reference, refreshing changed tiles
+static void diffTileRow(void *context, int tileRow) {
+    ChangeTracker *tracker = (ChangeTracker *)context;
+    const SonarImage *input = tracker->input;
+    int firstRow = tileRow * CHANGE_TILE;
+    int lastRow = firstRow + CHANGE_TILE < input->height ? firstRow + CHANGE_TILE : input->height;
+
+    for (int tileCol = 0; tileCol < tracker->tilesAcross; tileCol++) {
+        int firstCol = tileCol * CHANGE_TILE;
+        int count = input->width - firstCol < CHANGE_TILE ? input->width - firstCol : CHANGE_TILE;
+        bool changed = false;
+
+        for (int rowIndex = firstRow; rowIndex < lastRow && !changed; rowIndex++) {
+            changed = rowsDiffer(imageRow(input, rowIndex) + firstCol,
+                                 imageRow(&tracker->reference, rowIndex) + firstCol, count);
+        }
+        if (changed) {
+            for (int rowIndex = firstRow; rowIndex < lastRow; rowIndex++) {
+                memcpy(imageRow(&tracker->reference, rowIndex) + firstCol, imageRow(input, rowIndex) + firstCol,
+                       count * sizeof(Pixel));
+            }
+        }
+        tracker->changed[tileRow * tracker->tilesAcross + tileCol] = changed;
+    }
+}
+
+// Smooth the runs of marked tiles in one row of tiles
+static void resmoothTileRow(void *context, int tileRow) {
+    ChangeTracker *tracker = (ChangeTracker *)context;
+    const SonarImage *input = tracker->input;
+    const uint8_t *marks = tracker->resmooth + tileRow * tracker->tilesAcross;
+    int firstRow = tileRow * CHANGE_TILE;
+    int lastRow = firstRow + CHANGE_TILE < input->height ? firstRow + CHANGE_TILE : input->height;
+
+    for (int tileCol = 0; tileCol < tracker->tilesAcross; tileCol++) {
+        if (!marks[tileCol]) continue;
+        int runEnd = tileCol;
+        while (runEnd < tracker->tilesAcross && marks[runEnd]) runEnd++;
+
+        int lastCol = runEnd * CHANGE_TILE < input->width ? runEnd * CHANGE_TILE : input->width;
+        if (!boxFilterRegion(input, &tracker->smoothed, tracker->radius, tileCol * CHANGE_TILE, firstRow,
+                             lastCol, lastRow, tracker->filters)) {
+            atomic_store(&tracker->failed, true);
+        }
+        tileCol = runEnd;
+    }
+}
+
+// to[t] = any from[] within `halo` tiles of t, as a row pass then a column pass
+static int dilateTiles(ChangeTracker *tracker, const uint8_t *from, uint8_t *to, int halo) {
+    int across = tracker->tilesAcross, down = tracker->tilesDown, marked = 0;
+
+    for (int tileRow = 0; tileRow < down; tileRow++) {
+        for (int tileCol = 0; tileCol < across; tileCol++) {
+            uint8_t any = 0;
+            for (int col = tileCol - halo; col <= tileCol + halo && !any; col++) {
+                if (col >= 0 && col < across) any = from[tileRow * across + col];
+            }
+            tracker->scratch[tileRow * across + tileCol] = any;
+        }
+    }
+    for (int tileRow = 0; tileRow < down; tileRow++) {
+        for (int tileCol = 0; tileCol < across; tileCol++) {
+            uint8_t any = 0;
+            for (int row = tileRow - halo; row <= tileRow + halo && !any; row++) {
+                if (row >= 0 && row < down) any = tracker->scratch[row * across + tileCol];
+            }
+            to[tileRow * across + tileCol] = any;
+            marked += any;
         }
     }
+    return marked;
 }
 
-// Print the matrix using pointer arithmetic
-void printMatrix(int **matrixData, int matrixSize) {
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
-        for (int colIndex = 0; colIndex < matrixSize; colIndex++) {
-            printf("%4d", *(*(matrixData + rowIndex) + colIndex));
+// Where the input rectangle [x0,x1)×[y0,y1) of a width×height frame lands
+// after rotation: rows [top, bottom), columns [left, right)
+typedef struct {
+    int top, bottom, left, right;
+} RotatedRectangle;
+
+static RotatedRectangle rotateRectangle(int width, int height, int degrees, int x0, int y0, int x1, int y1) {
+    if (degrees == 90) return (RotatedRectangle){x0, x1, height - y1, height - y0};
+    if (degrees == 270) return (RotatedRectangle){width - x1, width - x0, y0, y1};
+    return (RotatedRectangle){height - y1, height - y0, width - x1, width - x0};
+}
+
+// The rectangle [x0,x1)×[y0,y1) of image as an image of its own
+static SonarImage imageView(const SonarImage *image, int x0, int y0, int x1, int y1) {
+    SonarImage view = *image;
+    view.width = x1 - x0;
+    view.height = y1 - y0;
+    view.pixels = imageRow(image, y0) + x0;
+    return view;
+}
+
+// Mark the label tiles of the rotated frame that overlap marked input tiles
+static void markLabelTiles(const ChangeTracker *tracker, const uint8_t *marks, const SonarImage *input,
+                          int degrees, uint8_t *labelDirty, int labelTilesAcross, int labelTilesDown) {
+    int width = input->width, height = input->height;
+    memset(labelDirty, 0, (size_t)labelTilesAcross * labelTilesDown);
+
+    for (int tileIndex = 0; tileIndex < tracker->tilesAcross * tracker->tilesDown; tileIndex++) {
+        if (!marks[tileIndex]) continue;
+        int x0 = tileIndex % tracker->tilesAcross * CHANGE_TILE, y0 = tileIndex / tracker->tilesAcross * CHANGE_TILE;
+        int x1 = x0 + CHANGE_TILE < width ? x0 + CHANGE_TILE : width;
+        int y1 = y0 + CHANGE_TILE < height ? y0 + CHANGE_TILE : height;
+        RotatedRectangle rotated = rotateRectangle(width, height, degrees, x0, y0, x1, y1);
+        int top = rotated.top, bottom = rotated.bottom, left = rotated.left, right = rotated.right;
+
+        for (int labelRow = top / LABEL_TILE; labelRow <= (bottom - 1) / LABEL_TILE; labelRow++) {
+            for (int labelCol = left / LABEL_TILE; labelCol <= (right - 1) / LABEL_TILE; labelCol++) {
+                labelDirty[labelRow * labelTilesAcross + labelCol] = 1;
+            }
         }
-        printf("\n");
     }
 }
 
-// Rotate the matrix 90° clockwise in-place
-void rotateMatrix90Clockwise(int **matrixData, int matrixSize) {
-    // Step 1: Transpose the matrix
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
-        for (int colIndex = rowIndex + 1; colIndex < matrixSize; colIndex++) {
-            int *elementPtr1 = *(matrixData + rowIndex) + colIndex;
-            int *elementPtr2 = *(matrixData + colIndex) + rowIndex;
-            int temp = *elementPtr1;
-            *elementPtr1 = *elementPtr2;
-            *elementPtr2 = temp;
+// Runs of tiles in one row of tiles that changed after the slot's frame,
+// either in their smoothed pixels or (reach) in their final pixels
+static void syncTileRow(ChangeTracker *tracker, int tileRow, bool reach) {
+    const long *changedAt = (reach ? tracker->reachedAt : tracker->smoothedAt) + tileRow * tracker->tilesAcross;
+    int width = tracker->smoothed.width, height = tracker->smoothed.height;
+    int y0 = tileRow * CHANGE_TILE;
+    int y1 = y0 + CHANGE_TILE < height ? y0 + CHANGE_TILE : height;
+
+    for (int tileCol = 0; tileCol < tracker->tilesAcross; tileCol++) {
+        if (changedAt[tileCol] <= tracker->since) continue;
+        int runEnd = tileCol;
+        while (runEnd < tracker->tilesAcross && changedAt[runEnd] > tracker->since) runEnd++;
+
+        int x0 = tileCol * CHANGE_TILE;
+        int x1 = runEnd * CHANGE_TILE < width ? runEnd * CHANGE_TILE : width;
+        RotatedRectangle rotated = rotateRectangle(width, height, tracker->degrees, x0, y0, x1, y1);
+        if (!reach) {
+            SonarImage tiles = imageView(&tracker->smoothed, x0, y0, x1, y1);
+            SonarImage target = imageView(tracker->output, rotated.left, rotated.top, rotated.right, rotated.bottom);
+            rotateImage(&tiles, &target, tracker->degrees);
+        }
+        else if (!convolveRegion(tracker->output, tracker->filtered, tracker->kernel,
+                                 rotated.left, rotated.top, rotated.right, rotated.bottom, tracker->filters)) {
+            atomic_store(&tracker->failed, true);
         }
+        tileCol = runEnd;
     }
+}
 
-    // Step 2: Reverse each row
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
-        int *leftPtr = *(matrixData + rowIndex);
-        int *rightPtr = leftPtr + matrixSize - 1;
+static void rerotateTileRow(void *context, int tileRow) {
+    syncTileRow((ChangeTracker *)context, tileRow, false);
+}
+
+// runs after every stale tile is rotated, as the kernel reads across tiles
+static void reconvolveTileRow(void *context, int tileRow) {
+    syncTileRow((ChangeTracker *)context, tileRow, true);
+}
+
+// Bring a frame slot from the frame it last held (*syncedSerial) to the
+// current one. Returns false on allocation failure.
+static bool syncFrameSlot(ChangeTracker *tracker, SonarImage *output, SonarImage *filtered,
+                          const ConvolutionKernel *kernel, long *syncedSerial) {
+    int tileCount = tracker->tilesAcross * tracker->tilesDown, stale = 0;
+    for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+        stale += tracker->reachedAt[tileIndex] > *syncedSerial;
+    }
+
+    if (stale * 4 > tileCount * 3) {
+        rotateImage(&tracker->smoothed, output, tracker->degrees);
+        if (kernel != NULL && !convolveImage(output, filtered, kernel, tracker->filters)) return false;
+    }
+    else if (stale > 0) {
+        tracker->output = output;
+        tracker->filtered = filtered;
+        tracker->kernel = kernel;
+        tracker->since = *syncedSerial;
+        parallelFor(tracker->tilesDown, rerotateTileRow, tracker);
+        if (kernel != NULL) parallelFor(tracker->tilesDown, reconvolveTileRow, tracker);
+        if (atomic_load(&tracker->failed)) return false;
+    }
+    tracker->tilesSynced += stale;
+    *syncedSerial = tracker->serial;
+    return true;
+}
+
+// Rotate and smooth `input` into `output`, then convolve it into `filtered`
+// when a kernel is given, reusing the previous frame's work; the slot's
+// buffers last held frame *syncedSerial (0 for none). Also marks the label
+// tiles whose pixels may have changed. Produces the same pixels as
+// rotateAndSmoothImage and convolveImage. Returns the number of tiles
+// smoothed again, or -1 on allocation failure.
+int applyFrameChanges(ChangeTracker *tracker, const SonarImage *input, SonarImage *output, SonarImage *filtered,
+                      const ConvolutionKernel *kernel, long *syncedSerial, int degrees, int radius,
+                      uint8_t *labelDirty, int labelTilesAcross, int labelTilesDown) {
+    int tileCount = tracker->tilesAcross * tracker->tilesDown;
+    int redone = tileCount;
+    int extraHalo = kernel != NULL ? kernel->size / 2 : 0;
+    bool fullPass = !tracker->primed || radius > MAX_FILTER_RADIUS;
+
+    tracker->input = input;
+    tracker->radius = radius;
+    tracker->degrees = degrees;
+    tracker->serial++;
+    atomic_store(&tracker->failed, false);
+
+    if (!fullPass) {
+        parallelFor(tracker->tilesDown, diffTileRow, tracker);
+        redone = dilateTiles(tracker, tracker->changed, tracker->resmooth, (radius + CHANGE_TILE - 1) / CHANGE_TILE);
+        fullPass = redone * 4 > tileCount * 3;
+    }
 
-        while (leftPtr < rightPtr) {
-            int temp = *leftPtr;
-            *leftPtr = *rightPtr;
-            *rightPtr = temp;
-            leftPtr++;
-            rightPtr--;
+    if (fullPass) {
+        for (int rowIndex = 0; rowIndex < input->height; rowIndex++) {
+            memcpy(imageRow(&tracker->reference, rowIndex), imageRow(input, rowIndex), input->width * sizeof(Pixel));
+        }
+        if (!applyBoxFilter(input, &tracker->smoothed, radius, tracker->filters)) return -1;
+        for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+            tracker->smoothedAt[tileIndex] = tracker->reachedAt[tileIndex] = tracker->serial;
+        }
+        memset(labelDirty, 1, (size_t)labelTilesAcross * labelTilesDown);
+        redone = tileCount;
+        tracker->primed = true;
+    }
+    else {
+        parallelFor(tracker->tilesDown, resmoothTileRow, tracker);
+        if (atomic_load(&tracker->failed)) return -1;
+        dilateTiles(tracker, tracker->changed, tracker->reach, (radius + extraHalo + CHANGE_TILE - 1) / CHANGE_TILE);
+        for (int tileIndex = 0; tileIndex < tileCount; tileIndex++) {
+            if (tracker->resmooth[tileIndex]) tracker->smoothedAt[tileIndex] = tracker->serial;
+            if (tracker->reach[tileIndex]) tracker->reachedAt[tileIndex] = tracker->serial;
         }
+        markLabelTiles(tracker, tracker->reach, input, degrees, labelDirty, labelTilesAcross, labelTilesDown);
     }
+
+    if (!syncFrameSlot(tracker, output, filtered, kernel, syncedSerial)) return -1;
+    tracker->tilesRedone += redone;
+    tracker->tilesSeen += tileCount;
+    return redone;
 }
 
-// Apply 3×3 smoothing filter 
-void applySmoothingFilter(int **matrixData, int matrixSize) {
-    int *prevRow = (int *)malloc(matrixSize * sizeof(int));
-    int *currRow = (int *)malloc(matrixSize * sizeof(int));
-    int *nextRow = (int *)malloc(matrixSize * sizeof(int));
-
-     if (prevRow == NULL || currRow == NULL || nextRow == NULL) {
-        printf("Memory allocation failed while creating row buffers!\n");
-        free(prevRow);
-        free(currRow);
-        free(nextRow);
-        return ;
+// Command-line settings shared by the interactive and pipeline modes
+typedef struct {
+    int rotationDegrees;
+    int filterRadius;
+    int threshold;
+    int minBlobArea;
+    double trackDistance;
+    double budgetMs;
+    const char *pipelineInput;
+    const char *inputPath;        // interactive mode: frame file instead of random data
+    const char *outputPath;
+    bool incremental;             // pipeline: reuse unchanged tiles of the previous frame
+    bool useKernel;               // --kernel: convolve after smoothing
+    ConvolutionKernel kernel;
+    int frameWidth;
+    int frameHeight;
+    int benchMaxSize;             // --bench: largest frame edge, 0 when off
+} SonarOptions;
+
+bool parseFrameSize(const char *text, int *width, int *height) {
+    char extraChar;
+    return sscanf(text, "%dx%d%c", width, height, &extraChar) == 2 &&
+           *width >= 2 && *width <= MAX_MATRIX_SIZE && *height >= 2 && *height <= MAX_MATRIX_SIZE;
+}
+
+// options: --rotate 90|180|270, --radius R, --threads N, --threshold T,
+//          --min-area A, --track-distance D, --budget-ms MS,
+//          --kernel gaussianK|boxK|sobel-x|sobel-y|w,w,...[/divisor],
+//          --input FILE [--size WxH] [--output FILE],
+//          --pipeline FILE [--size WxH] [--output FILE] [--incremental on|off],
+//          --bench MAXSIZE
+// Raw frame files need --size; PGM files carry their own dimensions.
+bool parseOptions(int argc, char *argv[], SonarOptions *options) {
+    options->rotationDegrees = 90;
+    options->filterRadius = 1;
+    options->threshold = PIXEL_MAX * 3 / 4;
+    options->minBlobArea = 4;
+    options->trackDistance = 20.0;
+    options->budgetMs = 0;
+    options->pipelineInput = NULL;
+    options->inputPath = NULL;
+    options->outputPath = NULL;
+    options->useKernel = false;
+    options->incremental = true;
+    options->frameWidth = options->frameHeight = 0;
+    options->benchMaxSize = 0;
+
+    for (int argIndex = 1; argIndex < argc; argIndex += 2) {
+        const char *option = argv[argIndex];
+        if (argIndex + 1 >= argc) {
+            printf("Missing value for %s\n", option);
+            return false;
+        }
+        const char *value = argv[argIndex + 1];
+
+        if (strcmp(option, "--rotate") == 0) {
+            options->rotationDegrees = atoi(value);
+            if (options->rotationDegrees != 90 && options->rotationDegrees != 180 && options->rotationDegrees != 270) {
+                printf("Rotation must be 90, 180 or 270 degrees.\n");
+                return false;
+            }
+        }
+        else if (strcmp(option, "--radius") == 0) {
+            options->filterRadius = atoi(value);
+            if (options->filterRadius < 1 || options->filterRadius > MAX_MATRIX_SIZE) {
+                printf("Filter radius must be between 1 and %d.\n", MAX_MATRIX_SIZE);
+                return false;
+            }
+        }
+        else if (strcmp(option, "--threads") == 0) {
+            int threads = atoi(value);
+            if (threads < 1 || threads > MAX_WORKER_THREADS) {
+                printf("Thread count must be between 1 and %d.\n", MAX_WORKER_THREADS);
+                return false;
+            }
+            setWorkerThreads(threads);
+        }
+        else if (strcmp(option, "--threshold") == 0) {
+            options->threshold = atoi(value);
+            if (options->threshold < 0 || options->threshold > PIXEL_MAX) {
+                printf("Threshold must be between 0 and %d.\n", PIXEL_MAX);
+                return false;
+            }
+        }
+        else if (strcmp(option, "--min-area") == 0) {
+            options->minBlobArea = atoi(value);
+            if (options->minBlobArea < 1) {
+                printf("Minimum blob area must be at least 1 pixel.\n");
+                return false;
+            }
+        }
+        else if (strcmp(option, "--track-distance") == 0) {
+            options->trackDistance = atof(value);
+            if (options->trackDistance <= 0) {
+                printf("Track distance must be positive.\n");
+                return false;
+            }
+        }
+        else if (strcmp(option, "--budget-ms") == 0) {
+            options->budgetMs = atof(value);
+            if (options->budgetMs <= 0) {
+                printf("Latency budget must be positive.\n");
+                return false;
+            }
+        }
+        else if (strcmp(option, "--kernel") == 0) {
+            if (!parseKernelSpec(value, &options->kernel)) {
+                printf("Invalid kernel: use gaussianK, boxK, sobel-x, sobel-y or K×K weights (odd K up to %d).\n",
+                       MAX_KERNEL_SIZE);
+                return false;
+            }
+            options->useKernel = true;
+        }
+        else if (strcmp(option, "--pipeline") == 0) {
+            options->pipelineInput = value;
+        }
+        else if (strcmp(option, "--incremental") == 0) {
+            if (strcmp(value, "on") != 0 && strcmp(value, "off") != 0) {
+                printf("--incremental takes on or off.\n");
+                return false;
+            }
+            options->incremental = strcmp(value, "on") == 0;
+        }
+        else if (strcmp(option, "--bench") == 0) {
+            options->benchMaxSize = atoi(value);
+            if (options->benchMaxSize < BENCH_MIN_SIZE || options->benchMaxSize > MAX_MATRIX_SIZE) {
+                printf("Benchmark size must be between %d and %d.\n", BENCH_MIN_SIZE, MAX_MATRIX_SIZE);
+                return false;
+            }
+        }
+        else if (strcmp(option, "--input") == 0) {
+            options->inputPath = value;
+        }
+        else if (strcmp(option, "--size") == 0) {
+            if (!parseFrameSize(value, &options->frameWidth, &options->frameHeight)) {
+                printf("Frame size must be WIDTHxHEIGHT with sides between 2 and %d.\n", MAX_MATRIX_SIZE);
+                return false;
+            }
+        }
+        else if (strcmp(option, "--output") == 0) {
+            options->outputPath = value;
+        }
+        else {
+            printf("Unknown option %s\n", option);
+            return false;
+        }
     }
-    
-    for (int colIndex = 0; colIndex < matrixSize; colIndex++) {
-        *(prevRow + colIndex) = 0;  // Prevent uninitialized reads
-        *(currRow + colIndex) = *(*(matrixData + 0) + colIndex);
-        *(nextRow + colIndex) = *(*(matrixData + 1) + colIndex);  
+    return true;
+}
+
+// Bounded lock-free single-producer/single-consumer ring connecting two
+// pipeline stages. Indices only grow; the slot is index % capacity. A stage
+// facing a full or empty ring polls it briefly, then sleeps on `changed`
+// until the other side moves; the lock is only taken when someone sleeps.
+struct SonarFrame;
+
+typedef struct {
+    atomic_size_t head;   // next index the consumer reads
+    atomic_size_t tail;   // next index the producer writes
+    atomic_int sleepers;  // stages blocked, or about to block, on this ring
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    struct SonarFrame *items[PIPELINE_QUEUE_SIZE];
+} FrameQueue;
+
+void initFrameQueue(FrameQueue *queue) {
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->sleepers, 0);
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+}
+
+void destroyFrameQueue(FrameQueue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+}
+
+// Wait until `index` (head or tail) no longer equals `blocked`. The sleeper
+// count is raised before the index is checked again, and wakeFrameQueue
+// reads it after moving the index, so one of the two always sees the other.
+static void waitForFrameQueue(FrameQueue *queue, atomic_size_t *index, size_t blocked) {
+    for (int spins = 0; spins < QUEUE_SPIN_LIMIT; spins++) {
+        if (atomic_load_explicit(index, memory_order_acquire) != blocked) return;
+    }
+    pthread_mutex_lock(&queue->lock);
+    atomic_fetch_add(&queue->sleepers, 1);
+    while (atomic_load(index) == blocked) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
     }
+    atomic_fetch_sub(&queue->sleepers, 1);
+    pthread_mutex_unlock(&queue->lock);
+}
 
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++) {
-        if (rowIndex < matrixSize - 1) {
-            for (int colIndex = 0; colIndex < matrixSize; colIndex++)
-                *(nextRow + colIndex) = *(*(matrixData + rowIndex + 1) + colIndex);
+static void wakeFrameQueue(FrameQueue *queue) {
+    if (atomic_load(&queue->sleepers) > 0) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+void pushFrame(FrameQueue *queue, struct SonarFrame *frame) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == PIPELINE_QUEUE_SIZE) waitForFrameQueue(queue, &queue->head, head);
+    queue->items[tail % PIPELINE_QUEUE_SIZE] = frame;
+    atomic_store(&queue->tail, tail + 1);
+    wakeFrameQueue(queue);
+}
+
+struct SonarFrame *popFrame(FrameQueue *queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (atomic_load_explicit(&queue->tail, memory_order_acquire) == head) {
+        waitForFrameQueue(queue, &queue->tail, head);
+    }
+    struct SonarFrame *frame = queue->items[head % PIPELINE_QUEUE_SIZE];
+    atomic_store(&queue->head, head + 1);
+    wakeFrameQueue(queue);
+    return frame;
+}
+
+// Rotation and smoothing run as one fused stage, followed by the optional
+// convolution kernel
+typedef enum {
+    STAGE_DECODE,
+    STAGE_TRANSFORM,
+    STAGE_DETECT,
+    STAGE_OUTPUT,
+    STAGE_COUNT
+} PipelineStage;
+
+static const char *stageNames[STAGE_COUNT] = {"decode", "transform", "detect", "output"};
+
+// One frame slot; all buffers are allocated once and reused
+typedef struct SonarFrame {
+    long frameIndex;          // -1 marks the end of the stream
+    SonarImage input;         // the decoded frame: a view onto the mapped file, or `source`
+    SonarImage source;
+    SonarImage smoothed;
+    SonarImage filtered;      // only allocated with --kernel
+    uint8_t *labelDirty;      // label tiles the detect stage must redo
+    int tilesRedone;          // change tiles smoothed again, -1 for a full fused pass
+    long changeSerial;        // ChangeTracker frame smoothed and filtered hold, 0 for none
+    Blob blobs[MAX_BLOBS_PER_FRAME];
+    int blobCount;
+    int trackCount;
+    double stageStartMs[STAGE_COUNT];   // per-stage timestamps for latency accounting
+    double stageEndMs[STAGE_COUNT];
+} SonarFrame;
+
+// per-stage latency totals gathered by the output stage
+typedef struct {
+    double totalMs[STAGE_COUNT];
+    double worstMs[STAGE_COUNT];
+    double totalLatencyMs;
+    double worstLatencyMs;
+    long framesOverBudget;
+} LatencyReport;
+
+// queue[i] feeds stage i; the decode stage is fed recycled frames by output
+typedef struct {
+    const SonarOptions *options;
+    FrameFile input;
+    FILE *output;
+    bool outputPgm;
+    FrameQueue queues[STAGE_COUNT];
+    SonarFrame frames[PIPELINE_FRAME_SLOTS];
+    ChangeTracker changes;    // owned by the transform stage
+    FilterWorkspace filters;  // scratch for the transform stage's kernels
+    BlobLabeler labeler;      // owned by the detect stage
+    Tracker tracker;
+    LatencyReport latency;    // owned by the output stage
+    long framesProcessed;
+    atomic_bool failed;
+} SonarPipeline;
+
+typedef struct {
+    SonarPipeline *pipeline;
+    PipelineStage stage;
+} StageContext;
+
+// rotate and smooth (incrementally if enabled), then apply the kernel
+static void transformFrame(SonarPipeline *pipeline, SonarFrame *frame) {
+    const SonarOptions *options = pipeline->options;
+    bool transformed;
+
+    if (options->incremental) {
+        frame->tilesRedone = applyFrameChanges(&pipeline->changes, &frame->input, &frame->smoothed,
+                                               &frame->filtered, options->useKernel ? &options->kernel : NULL,
+                                               &frame->changeSerial, options->rotationDegrees,
+                                               options->filterRadius, frame->labelDirty,
+                                               pipeline->labeler.tilesAcross, pipeline->labeler.tilesDown);
+        transformed = frame->tilesRedone >= 0;
+    }
+    else {
+        frame->tilesRedone = -1;
+        transformed = rotateAndSmoothImage(&frame->input, &frame->smoothed, options->rotationDegrees,
+                                           options->filterRadius, &pipeline->filters) &&
+                      (!options->useKernel ||
+                       convolveImage(&frame->smoothed, &frame->filtered, &options->kernel, &pipeline->filters));
+    }
+    if (!transformed) atomic_store(&pipeline->failed, true);
+}
+
+// the processed frame handed to detection and output
+static inline const SonarImage *frameResult(const SonarPipeline *pipeline, const SonarFrame *frame) {
+    return pipeline->options->useKernel ? &frame->filtered : &frame->smoothed;
+}
+
+// label the processed frame and associate its blobs with the running tracks
+static void detectObjects(SonarPipeline *pipeline, SonarFrame *frame) {
+    const SonarOptions *options = pipeline->options;
+    const uint8_t *dirtyTiles = options->incremental ? frame->labelDirty : NULL;
+    int blobCount = findBlobs(&pipeline->labeler, frameResult(pipeline, frame), dirtyTiles,
+                              options->minBlobArea, frame->blobs, MAX_BLOBS_PER_FRAME);
+    if (blobCount < 0) {
+        atomic_store(&pipeline->failed, true);
+        blobCount = 0;
+    }
+    frame->blobCount = blobCount;
+    updateTracks(&pipeline->tracker, frame->blobs, blobCount);
+    frame->trackCount = pipeline->tracker.trackCount;
+}
+
+// per-frame report line plus latency bookkeeping
+static void reportFrame(SonarPipeline *pipeline, const SonarFrame *frame, double finishedMs) {
+    LatencyReport *latency = &pipeline->latency;
+    double endToEnd = finishedMs - frame->stageStartMs[STAGE_DECODE];
+
+    printf("Frame %ld: %d objects, %d tracks", frame->frameIndex, frame->blobCount, frame->trackCount);
+    if (frame->tilesRedone >= 0) printf(", %d tiles redone", frame->tilesRedone);
+    printf(" |");
+    for (int stage = STAGE_DECODE; stage < STAGE_OUTPUT; stage++) {
+        double stageMs = frame->stageEndMs[stage] - frame->stageStartMs[stage];
+        latency->totalMs[stage] += stageMs;
+        if (stageMs > latency->worstMs[stage]) latency->worstMs[stage] = stageMs;
+        printf(" %s %.2f", stageNames[stage], stageMs);
+    }
+    printf(" ms, latency %.2f ms", endToEnd);
+
+    latency->totalLatencyMs += endToEnd;
+    if (endToEnd > latency->worstLatencyMs) latency->worstLatencyMs = endToEnd;
+    if (pipeline->options->budgetMs > 0 && endToEnd > pipeline->options->budgetMs) {
+        latency->framesOverBudget++;
+        printf(" (over budget)");
+    }
+    printf("\n");
+
+    for (int b = 0; b < frame->blobCount; b++) {
+        printBlob(&frame->blobs[b]);
+    }
+}
+
+static void printLatencySummary(const SonarPipeline *pipeline) {
+    const LatencyReport *latency = &pipeline->latency;
+    long frames = pipeline->framesProcessed;
+    if (frames == 0) return;
+
+    printf("Stage latency (mean / worst ms):");
+    for (int stage = STAGE_DECODE; stage < STAGE_OUTPUT; stage++) {
+        printf(" %s %.2f/%.2f", stageNames[stage], latency->totalMs[stage] / frames, latency->worstMs[stage]);
+    }
+    printf("\nEnd-to-end latency: mean %.2f ms, worst %.2f ms\n",
+           latency->totalLatencyMs / frames, latency->worstLatencyMs);
+    if (pipeline->options->budgetMs > 0) {
+        printf("Frames over the %.2f ms budget: %ld\n", pipeline->options->budgetMs, latency->framesOverBudget);
+    }
+    if (pipeline->options->incremental && pipeline->changes.tilesSeen > 0) {
+        printf("Incremental: %ld of %ld tiles smoothed again (%.1f%%), %ld refreshed in frame buffers (%.1f%%)\n",
+               pipeline->changes.tilesRedone, pipeline->changes.tilesSeen,
+               100.0 * pipeline->changes.tilesRedone / pipeline->changes.tilesSeen, pipeline->changes.tilesSynced,
+               100.0 * pipeline->changes.tilesSynced / pipeline->changes.tilesSeen);
+    }
+}
+
+static void *runPipelineStage(void *argument) {
+    StageContext *context = (StageContext *)argument;
+    SonarPipeline *pipeline = context->pipeline;
+    FrameQueue *inbox = &pipeline->queues[context->stage];
+    FrameQueue *outbox = &pipeline->queues[(context->stage + 1) % STAGE_COUNT];
+    long nextIndex = 0;
+
+    while (1) {
+        SonarFrame *frame = popFrame(inbox);
+        frame->stageStartMs[context->stage] = monotonicMilliseconds();
+
+        switch (context->stage) {
+            case STAGE_DECODE:
+                frame->frameIndex = nextFrame(&pipeline->input, &frame->input, &frame->source) ? nextIndex++ : -1;
+                break;
+            case STAGE_TRANSFORM:
+                if (frame->frameIndex >= 0) transformFrame(pipeline, frame);
+                break;
+            case STAGE_DETECT:
+                if (frame->frameIndex >= 0) detectObjects(pipeline, frame);
+                break;
+            case STAGE_OUTPUT:
+                if (frame->frameIndex < 0) return NULL;
+                reportFrame(pipeline, frame, frame->stageStartMs[STAGE_OUTPUT]);
+                if (pipeline->output != NULL &&
+                    !writeFrame(pipeline->output, frameResult(pipeline, frame), pipeline->outputPgm)) {
+                    atomic_store(&pipeline->failed, true);
+                }
+                pipeline->framesProcessed++;
+                break;
+            default:
+                break;
+        }
+
+        // the frame belongs to the next stage once pushed, so read it first
+        bool endOfStream = frame->frameIndex < 0;
+        frame->stageEndMs[context->stage] = monotonicMilliseconds();
+        pushFrame(outbox, frame);
+        if (endOfStream) return NULL;
+    }
+}
+
+// release the frame slots, the labeler and the input mapping
+static void freePipelineFrames(SonarPipeline *pipeline) {
+    closeFrameFile(&pipeline->input);
+    freeChangeTracker(&pipeline->changes);
+    freeFilterWorkspace(&pipeline->filters);
+    freeBlobLabeler(&pipeline->labeler);
+    for (int slot = 0; slot < PIPELINE_FRAME_SLOTS; slot++) {
+        free(pipeline->frames[slot].labelDirty);
+        freeImage(&pipeline->frames[slot].source);
+        freeImage(&pipeline->frames[slot].smoothed);
+        freeImage(&pipeline->frames[slot].filtered);
+    }
+}
+
+// Stream raw frames from a file through decode → rotate+smooth[+kernel] → detect
+// → output, one thread per stage, with no allocation per frame in steady
+// state: the transform kernels work in a FilterWorkspace sized at startup,
+// and the labeler only grows its component lists and merge table when a
+// frame needs more
+int runPipeline(const SonarOptions *options) {
+    static SonarPipeline pipeline;
+    memset(&pipeline, 0, sizeof(pipeline));
+    pipeline.options = options;
+
+    if (!openFrameFile(&pipeline.input, options->pipelineInput, options->frameWidth, options->frameHeight)) {
+        return 1;
+    }
+    int width = pipeline.input.width, height = pipeline.input.height;
+    bool quarterTurn = options->rotationDegrees != 180;
+    int rotatedWidth = quarterTurn ? height : width;
+    int rotatedHeight = quarterTurn ? width : height;
+
+    for (int slot = 0; slot < PIPELINE_FRAME_SLOTS; slot++) {
+        SonarFrame *frame = &pipeline.frames[slot];
+        if (!createImage(&frame->source, width, height) ||
+            !createImage(&frame->smoothed, rotatedWidth, rotatedHeight) ||
+            (options->useKernel && !createImage(&frame->filtered, rotatedWidth, rotatedHeight))) {
+            printf("Memory allocation failed for frame buffers!\n");
+            freePipelineFrames(&pipeline);
+            return 1;
+        }
+    }
+    if (!initBlobLabeler(&pipeline.labeler, rotatedWidth, rotatedHeight, options->threshold) ||
+        !initFilterWorkspace(&pipeline.filters, width, height, options->useKernel ? options->kernel.size : 0,
+                             options->filterRadius) ||
+        (options->incremental && !initChangeTracker(&pipeline.changes, width, height, &pipeline.filters))) {
+        printf("Memory allocation failed for the labeler!\n");
+        freePipelineFrames(&pipeline);
+        return 1;
+    }
+    for (int slot = 0; slot < PIPELINE_FRAME_SLOTS && options->incremental; slot++) {
+        pipeline.frames[slot].labelDirty = (uint8_t *)malloc((size_t)pipeline.labeler.tilesAcross *
+                                                             pipeline.labeler.tilesDown);
+        if (pipeline.frames[slot].labelDirty == NULL) {
+            printf("Memory allocation failed for the labeler!\n");
+            freePipelineFrames(&pipeline);
+            return 1;
+        }
+    }
+    initTracker(&pipeline.tracker, options->trackDistance);
+
+    if (options->outputPath != NULL) {
+        pipeline.outputPgm = pathIsPgm(options->outputPath);
+        pipeline.output = fopen(options->outputPath, "wb");
+        if (pipeline.output == NULL) {
+            printf("Could not create %s\n", options->outputPath);
+            freePipelineFrames(&pipeline);
+            return 1;
+        }
+    }
+
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        initFrameQueue(&pipeline.queues[stage]);
+    }
+    for (int slot = 0; slot < PIPELINE_FRAME_SLOTS; slot++) {
+        pushFrame(&pipeline.queues[STAGE_DECODE], &pipeline.frames[slot]);
+    }
+
+    pthread_t threads[STAGE_COUNT];
+    StageContext contexts[STAGE_COUNT];
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        contexts[stage].pipeline = &pipeline;
+        contexts[stage].stage = (PipelineStage)stage;
+        if (pthread_create(&threads[stage], NULL, runPipelineStage, &contexts[stage]) != 0) {
+            // the stages already started would never see the end of the stream
+            printf("Could not start pipeline threads!\n");
+            exit(1);
         }
+    }
+    for (int stage = 0; stage < STAGE_COUNT; stage++) {
+        pthread_join(threads[stage], NULL);
+        destroyFrameQueue(&pipeline.queues[stage]);
+    }
+
+    printf("Processed %ld frames\n", pipeline.framesProcessed);
+    printLatencySummary(&pipeline);
+
+    if (pipeline.output != NULL && fclose(pipeline.output) != 0) atomic_store(&pipeline.failed, true);
+    freePipelineFrames(&pipeline);
+
+    if (atomic_load(&pipeline.failed)) {
+        printf("Pipeline failed while filtering or writing frames!\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Benchmark mode: times each kernel on random square frames from
+// BENCH_MIN_SIZE² up to MAXSIZE², across thread counts for the parallel
+// ones, and checks every result against a straightforward reference
+// implementation of the same operation.
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_CYCLE_COUNTER 1
+static inline uint64_t readCycleCounter(void) {
+    return __rdtsc();
+}
+#else
+#define HAVE_CYCLE_COUNTER 0
+static inline uint64_t readCycleCounter(void) {
+    return 0;
+}
+#endif
+
+typedef struct {
+    SonarImage source;
+    SonarImage work;          // kernel output, or the buffer changed in place
+    SonarImage expected;      // reference result
+    SonarImage scratch;
+    ConvolutionKernel gaussian;
+    SummedAreaTable table;
+} BenchFrames;
 
-        for (int colIndex = 0; colIndex < matrixSize; colIndex++) {
-            int sum = 0, count = 0;
+typedef struct {
+    const char *name;
+    bool parallel;            // uses the worker pool
+    bool inPlace;             // work starts as a copy of the source
+    double bytesPerPixel;     // memory traffic per pixel
+    bool (*run)(BenchFrames *frames);
+    void (*reference)(BenchFrames *frames);
+    bool (*check)(BenchFrames *frames);
+} BenchCase;
+
+static void copyPixels(const SonarImage *src, SonarImage *dst) {
+    for (int rowIndex = 0; rowIndex < src->height; rowIndex++) {
+        memcpy(imageRow(dst, rowIndex), imageRow(src, rowIndex), src->width * sizeof(Pixel));
+    }
+}
 
-            for (int rowOffset = -1; rowOffset <= 1; rowOffset++) {
-                int neighborRow = rowIndex + rowOffset;
-                if (neighborRow < 0 || neighborRow >= matrixSize)
-                    continue;
+static void referenceRotate90(const SonarImage *src, SonarImage *dst) {
+    for (int rowIndex = 0; rowIndex < src->height; rowIndex++) {
+        for (int colIndex = 0; colIndex < src->width; colIndex++) {
+            imageRow(dst, colIndex)[src->height - 1 - rowIndex] = imageRow(src, rowIndex)[colIndex];
+        }
+    }
+}
 
-                int *rowPointer;
-                if (rowOffset == -1) {
-                    // Skip prevRow for first row - prevent incorrect averaging
-                    if (rowIndex == 0) continue;
-                    rowPointer = prevRow;
+// the original neighbour-counting 3×3 mean
+static void referenceSmooth3x3(const SonarImage *src, SonarImage *dst) {
+    for (int rowIndex = 0; rowIndex < src->height; rowIndex++) {
+        for (int colIndex = 0; colIndex < src->width; colIndex++) {
+            uint32_t sum = 0, count = 0;
+            for (int dRow = -1; dRow <= 1; dRow++) {
+                for (int dCol = -1; dCol <= 1; dCol++) {
+                    int row = rowIndex + dRow, col = colIndex + dCol;
+                    if (row >= 0 && row < src->height && col >= 0 && col < src->width) {
+                        sum += imageRow(src, row)[col];
+                        count++;
+                    }
                 }
-                else if (rowOffset == 0) rowPointer = currRow;
-                else {
-                    // Skip nextRow for last row - prevent incorrect averaging
-                    if (rowIndex == matrixSize - 1) continue;
-                    rowPointer = nextRow;
+            }
+            imageRow(dst, rowIndex)[colIndex] = (Pixel)(sum / count);
+        }
+    }
+}
+
+static void referenceConvolve(const SonarImage *src, SonarImage *dst, const ConvolutionKernel *kernel) {
+    int size = kernel->size, radius = size / 2;
+    for (int rowIndex = 0; rowIndex < src->height; rowIndex++) {
+        for (int colIndex = 0; colIndex < src->width; colIndex++) {
+            int64_t sum = 0;
+            for (int i = 0; i < size; i++) {
+                const Pixel *row = imageRow(src, clampIndex(rowIndex + i - radius, src->height));
+                for (int j = 0; j < size; j++) {
+                    sum += (int64_t)kernel->weights[i * size + j] * row[clampIndex(colIndex + j - radius, src->width)];
                 }
+            }
+            imageRow(dst, rowIndex)[colIndex] = convolutionResult(sum, kernel->divisor);
+        }
+    }
+}
+
+static bool benchRotateInPlace(BenchFrames *frames) {
+    rotateMatrix90Clockwise(&frames->work);
+    return true;
+}
+
+static bool benchRotate(BenchFrames *frames) {
+    return rotateImage(&frames->source, &frames->work, 90);
+}
+
+static bool benchSmoothing(BenchFrames *frames) {
+    applySmoothingFilter(&frames->work);
+    return true;
+}
+
+static bool benchBoxFilter(BenchFrames *frames) {
+    return applyBoxFilter(&frames->source, &frames->work, 1, NULL);
+}
+
+static bool benchRotateSmooth(BenchFrames *frames) {
+    return rotateAndSmoothImage(&frames->source, &frames->work, 90, 1, NULL);
+}
+
+static bool benchGaussian(BenchFrames *frames) {
+    return convolveImage(&frames->source, &frames->work, &frames->gaussian, NULL);
+}
+
+static bool benchSummedArea(BenchFrames *frames) {
+    buildSummedAreaTable(&frames->table, &frames->source);
+    return true;
+}
+
+static void expectRotation(BenchFrames *frames) {
+    referenceRotate90(&frames->source, &frames->expected);
+}
+
+static void expectSmoothing(BenchFrames *frames) {
+    referenceSmooth3x3(&frames->source, &frames->expected);
+}
+
+static void expectRotateSmooth(BenchFrames *frames) {
+    referenceRotate90(&frames->source, &frames->scratch);
+    referenceSmooth3x3(&frames->scratch, &frames->expected);
+}
+
+static void expectGaussian(BenchFrames *frames) {
+    referenceConvolve(&frames->source, &frames->expected, &frames->gaussian);
+}
+
+static bool matchesExpected(BenchFrames *frames) {
+    for (int rowIndex = 0; rowIndex < frames->work.height; rowIndex++) {
+        if (memcmp(imageRow(&frames->work, rowIndex), imageRow(&frames->expected, rowIndex),
+                   frames->work.width * sizeof(Pixel)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// rectangle sums from the table against direct sums over random rectangles
+static bool summedAreaMatches(BenchFrames *frames) {
+    const SonarImage *source = &frames->source;
+    for (int probe = 0; probe < 32; probe++) {
+        int x0 = rand() % source->width, y0 = rand() % source->height;
+        int x1 = x0 + 1 + rand() % (source->width - x0 < 256 ? source->width - x0 : 256);
+        int y1 = y0 + 1 + rand() % (source->height - y0 < 256 ? source->height - y0 : 256);
+        uint64_t sum = 0;
+        for (int rowIndex = y0; rowIndex < y1; rowIndex++) {
+            for (int colIndex = x0; colIndex < x1; colIndex++) sum += imageRow(source, rowIndex)[colIndex];
+        }
+        if (sum != rectangleSum(&frames->table, x0, y0, x1, y1)) return false;
+    }
+    return true;
+}
+
+static const BenchCase benchCases[] = {
+    {"rotate90 in place", false, true, 2, benchRotateInPlace, expectRotation, matchesExpected},
+    {"rotate90", false, false, 2, benchRotate, expectRotation, matchesExpected},
+    {"smooth 3x3 in place", true, true, 3, benchSmoothing, expectSmoothing, matchesExpected},
+    {"box filter r=1", true, false, 2, benchBoxFilter, expectSmoothing, matchesExpected},
+    {"rotate+smooth", true, false, 2, benchRotateSmooth, expectRotateSmooth, matchesExpected},
+    {"gaussian5", true, false, 2, benchGaussian, expectGaussian, matchesExpected},
+    {"summed-area table", false, false, 1 + 8.0 / sizeof(Pixel), benchSummedArea, NULL, summedAreaMatches},
+};
 
-                for (int colOffset = -1; colOffset <= 1; colOffset++) {
-                    int neighborCol = colIndex + colOffset;
-                    if (neighborCol < 0 || neighborCol >= matrixSize)
-                        continue;
+static void freeBenchFrames(BenchFrames *frames) {
+    freeImage(&frames->source);
+    freeImage(&frames->work);
+    freeImage(&frames->expected);
+    freeImage(&frames->scratch);
+    freeSummedAreaTable(&frames->table);
+}
+
+// Run every kernel once to check it, then repeat it for timing; the best
+// run is reported. Returns the number of failed checks.
+static int benchmarkSize(BenchFrames *frames, int maxThreads) {
+    int size = frames->source.width, failures = 0;
+    double pixels = (double)size * size;
+
+    for (size_t caseIndex = 0; caseIndex < sizeof(benchCases) / sizeof(benchCases[0]); caseIndex++) {
+        const BenchCase *bench = &benchCases[caseIndex];
+        if (bench->reference != NULL) bench->reference(frames);
+
+        for (int threads = 1; threads <= (bench->parallel ? maxThreads : 1); threads *= 2) {
+            setWorkerThreads(threads);
+            if (bench->inPlace) copyPixels(&frames->source, &frames->work);
+            bool passed = bench->run(frames) && bench->check(frames);
+            failures += !passed;
 
-                    sum += *(rowPointer + neighborCol);
-                    count++;
+            double best = 0, spent = 0;
+            uint64_t bestCycles = 0;
+            for (int runs = 0; runs < BENCH_MIN_RUNS || (spent < BENCH_MIN_MS && runs < BENCH_MAX_RUNS); runs++) {
+                uint64_t startCycles = readCycleCounter();
+                double start = monotonicMilliseconds();
+                bench->run(frames);
+                double elapsed = monotonicMilliseconds() - start;
+                uint64_t cycles = readCycleCounter() - startCycles;
+                if (runs == 0 || elapsed < best) {
+                    best = elapsed;
+                    bestCycles = cycles;
                 }
+                spent += elapsed;
             }
 
-            if (count > 0) {
-                *(*(matrixData + rowIndex) + colIndex) = sum / count;
-            }
+            double nanoseconds = best * 1e6 > 1 ? best * 1e6 : 1;
+            printf("%-20s %5dx%-5d %7d %10.3f %8.2f %7.3f ", bench->name, size, size, threads, best,
+                   pixels * bench->bytesPerPixel * sizeof(Pixel) / nanoseconds, pixels / nanoseconds);
+            if (HAVE_CYCLE_COUNTER) printf("%9.2f", bestCycles / pixels);
+            else printf("%9s", "n/a");
+            printf("  %s\n", passed ? "ok" : "MISMATCH");
+        }
+    }
+    return failures;
+}
+
+int runBenchmarks(int maxSize) {
+    int maxThreads = workerThreadCount();
+    int failures = 0;
+
+    printf("Benchmark: %d-bit pixels, 1 to %d threads, best of at least %d runs%s\n", SONAR_PIXEL_BITS,
+           maxThreads, BENCH_MIN_RUNS, HAVE_CYCLE_COUNTER ? ", cycles from the time-stamp counter" : "");
+    printf("%-20s %11s %7s %10s %8s %7s %9s  %s\n", "kernel", "size", "threads", "ms/frame", "GB/s",
+           "px/ns", "cycles/px", "check");
+
+    for (int size = BENCH_MIN_SIZE; size <= maxSize; size *= 4) {
+        BenchFrames frames;
+        memset(&frames, 0, sizeof(frames));
+        parseKernelSpec("gaussian5", &frames.gaussian);
+        if (!createImage(&frames.source, size, size) || !createImage(&frames.work, size, size) ||
+            !createImage(&frames.expected, size, size) || !createImage(&frames.scratch, size, size) ||
+            !initSummedAreaTable(&frames.table, size, size)) {
+            printf("Memory allocation failed for %dx%d frames, stopping here.\n", size, size);
+            freeBenchFrames(&frames);
+            break;
+        }
+        generateRandomMatrix(&frames.source);
+        failures += benchmarkSize(&frames, maxThreads);
+        freeBenchFrames(&frames);
+        if (size > maxSize / 4 && size < maxSize) size = maxSize / 4;   // always finish at maxSize
+    }
+
+    setWorkerThreads(maxThreads);
+    if (failures > 0) {
+        printf("%d kernel results did not match the reference!\n", failures);
+        return 1;
+    }
+    printf("All kernel results match the reference.\n");
+    return 0;
+}
+
+// Rotate, smooth, filter and search one frame, printing each step, then
+// save it if requested. Frees the frame and the worker pool; returns the
+// exit status.
+static int processFrame(SonarImage *image, const SonarOptions *options) {
+    // Rotate matrix clockwise
+    if (!rotateFrame(image, options->rotationDegrees)) {
+        freeImage(image);
+        shutdownWorkerPool();
+        return 1;
+    }
+    char title[96];
+    snprintf(title, sizeof(title), "Matrix after %d° Clockwise Rotation", options->rotationDegrees);
+    showMatrix(title, image);
+
+    // Apply smoothing filter
+    applySmoothingFilterRadius(image, options->filterRadius);
+    snprintf(title, sizeof(title), "Matrix after Applying %d×%d Smoothing Filter",
+             2 * options->filterRadius + 1, 2 * options->filterRadius + 1);
+    showMatrix(title, image);
+
+    // Apply the optional convolution kernel
+    if (options->useKernel) {
+        SonarImage filtered;
+        if (!createImage(&filtered, image->width, image->height) ||
+            !convolveImage(image, &filtered, &options->kernel, NULL)) {
+            printf("Memory allocation failed while applying the kernel!\n");
+            freeImage(&filtered);
+            freeImage(image);
+            shutdownWorkerPool();
+            return 1;
         }
+        freeImage(image);
+        *image = filtered;
+        snprintf(title, sizeof(title), "Matrix after Applying %s Kernel%s", options->kernel.name,
+                 options->kernel.separable ? " (separable)" : "");
+        showMatrix(title, image);
+    }
+
+    // Detect bright objects in the smoothed frame
+    BlobLabeler labeler;
+    Blob blobs[MAX_BLOBS_PER_FRAME];
+    if (initBlobLabeler(&labeler, image->width, image->height, options->threshold)) {
+        Tracker tracker;
+        initTracker(&tracker, options->trackDistance);
+        int blobCount = findBlobs(&labeler, image, NULL, options->minBlobArea, blobs, MAX_BLOBS_PER_FRAME);
+        if (blobCount >= 0) {
+            updateTracks(&tracker, blobs, blobCount);
+            printf("\nDetected objects (intensity >= %d, area >= %d): %d\n",
+                   options->threshold, options->minBlobArea, blobCount);
+            for (int b = 0; b < blobCount && b < MAX_PRINT_SIZE; b++) printBlob(&blobs[b]);
+        }
+        freeBlobLabeler(&labeler);
+    }
 
-        if (rowIndex < matrixSize - 1) {
-            // Shift rows: prevRow = currRow, currRow = nextRow
-            for (int colIndex = 0; colIndex < matrixSize; colIndex++)
-                *(prevRow + colIndex) = *(currRow + colIndex);
-            for (int colIndex = 0; colIndex < matrixSize; colIndex++)
-                *(currRow + colIndex) = *(nextRow + colIndex);
+    // Save the final frame
+    int status = 0;
+    if (options->outputPath != NULL) {
+        if (writeImageFile(options->outputPath, image)) printf("\nSaved the frame to %s\n", options->outputPath);
+        else {
+            printf("Could not write %s\n", options->outputPath);
+            status = 1;
         }
     }
 
-    free(prevRow);
-    free(currRow);
-    free(nextRow);
+    // Free memory
+    freeImage(image);
+    shutdownWorkerPool();
+
+    return status;
 }
 
-int main() {
-    int matrixSize;
+int main(int argc, char *argv[]) {
+    int matrixSize, matrixHeight;
     char inputChar;
+    SonarOptions options;
+
+    if (!parseOptions(argc, argv, &options)) return 1;
+
+    if (options.benchMaxSize > 0) {
+        srand(time(0));
+        int status = runBenchmarks(options.benchMaxSize);
+        shutdownWorkerPool();
+        return status;
+    }
+    if (options.pipelineInput != NULL) {
+        int status = runPipeline(&options);
+        shutdownWorkerPool();
+        return status;
+    }
+    SonarImage image;
+
+    // Load a frame file instead of generating one
+    if (options.inputPath != NULL) {
+        FrameFile input;
+        if (!openFrameFile(&input, options.inputPath, options.frameWidth, options.frameHeight)) return 1;
+        bool loaded = loadFrameCopy(&input, &image);
+        closeFrameFile(&input);
+        if (!loaded) return 1;
+        showMatrix("Original Matrix", &image);
+        return processFrame(&image, &options);
+    }
 
-    printf("Enter matrix size (2-10): ");
+    printf("Enter matrix size (2-%d, or WIDTHxHEIGHT): ", MAX_MATRIX_SIZE);
 
-    if (scanf("%d%c", &matrixSize, &inputChar) != 2 || inputChar != '\n' || matrixSize < 2 || matrixSize > 10) {
-        printf("Invalid input! Please enter a number between 2 and 10.\n");
+    if (scanf("%d%c", &matrixSize, &inputChar) != 2 || matrixSize < 2 || matrixSize > MAX_MATRIX_SIZE) {
+        printf("Invalid input! Please enter a number between 2 and %d.\n", MAX_MATRIX_SIZE);
+        return 1;
+    }
+    matrixHeight = matrixSize;
+    if (inputChar == 'x' && (scanf("%d%c", &matrixHeight, &inputChar) != 2 ||
+                             matrixHeight < 2 || matrixHeight > MAX_MATRIX_SIZE)) {
+        printf("Invalid input! Height must be between 2 and %d.\n", MAX_MATRIX_SIZE);
+        return 1;
+    }
+    if (inputChar != '\n') {
+        printf("Invalid input! Please enter a number between 2 and %d.\n", MAX_MATRIX_SIZE);
         return 1;
     }
 
       srand(time(0));
     
     // Allocate memory for matrix
-    int **matrixData = (int **)malloc(matrixSize * sizeof(int *));
-     if (matrixData == NULL) {
-        printf("Memory allocation failed for matrix rows!\n");
+    if (!createImage(&image, matrixSize, matrixHeight)) {
+        printf("Memory allocation failed for matrix!\n");
         return 1;
     }
-    
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++)
-        *(matrixData + rowIndex) = (int *)malloc(matrixSize * sizeof(int));
 
     // Generate and display original matrix
-    generateRandomMatrix(matrixData, matrixSize);
-    printf("\nOriginal Randomly Generated Matrix:\n");
-    printMatrix(matrixData, matrixSize);
-
-    // Rotate matrix 90° clockwise
-    rotateMatrix90Clockwise(matrixData, matrixSize);
-    printf("\nMatrix after 90° Clockwise Rotation:\n");
-    printMatrix(matrixData, matrixSize);
-
-    // Apply smoothing filter
-    applySmoothingFilter(matrixData, matrixSize);
-    printf("\nMatrix after Applying 3×3 Smoothing Filter:\n");
-    printMatrix(matrixData, matrixSize);
+    generateRandomMatrix(&image);
+    showMatrix("Original Randomly Generated Matrix", &image);
+    return processFrame(&image, &options);
+}
 
-    // Free memory
-    for (int rowIndex = 0; rowIndex < matrixSize; rowIndex++)
-        free(*(matrixData + rowIndex));
-    free(matrixData);
 
-    return 0;
-}
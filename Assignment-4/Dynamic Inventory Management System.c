@@ -1,8 +1,38 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #define MAX_NAME_LENGTH 50
+#define MAX_PRODUCT_ID 100000000
+#define MIN_INVENTORY_CAPACITY 16
+#define DELETED_PRODUCT_ID 0 // tombstone marker, real IDs start at 1
+#define PRICE_MERGE_MIN 256   // pending price entries tolerated before a merge,
+#define PRICE_MERGE_SHARE 16  // or 1/16 of the sorted run when that is larger
+#define NAME_LISTS_MIN 1024   // initial trigram buckets, a power of two
+#define NAME_TAIL_MIN 32      // out-of-order postings tolerated before re-encoding
+#define INVENTORY_FILE_MAGIC "INVENTRY"
+#define INVENTORY_FILE_VERSION 1
+#define INVENTORY_FILE_HEADER 4096 // the header owns the first page
+#define IMPORT_MAX_THREADS 16
+#define IMPORT_MIN_CHUNK 65536      // CSV bytes worth handing to another thread
+#define IMPORT_BATCH 65536          // rows appended per table reservation
+#define MAX_STOCK_READERS 64
+#define STRESS_THREADS 32
+#define STRESS_PRODUCTS 10000
+#define STRESS_HOT_SKUS 8           // products nine orders in ten go to
+#define STRESS_HOT_STOCK 500000    // restocks nearly keep up, so the hot SKUs never run dry
+#define STRESS_ORDERS 200000        // per order thread
+#define STRESS_DRAIN_STOCK 1000     // per hot SKU when the threads race it down to zero
+#define STRESS_CHURN 500            // products each structural thread adds and retires
 
 typedef struct
 {
@@ -12,217 +42,2378 @@ typedef struct
     int productQuantity;
 } Product;
 
-void addNewProduct(Product **inventory, int *productCount);
-void viewAllProducts(Product *inventory, int productCount);
-void updateProductQuantity(Product *inventory, int productCount);
-void searchProductById(Product *inventory, int productCount);
-void searchProductByName(Product *inventory, int productCount);
-void searchProductByPriceRange(Product *inventory, int productCount);
-void deleteProductById(Product **inventory, int *productCount);
-void freeInventoryMemory(Product *inventory);
-bool checkIdExist(Product *inventory, int productCount, int product_id);
+// Stays valid while its product exists, even when compaction moves the product
+typedef struct
+{
+    int index;
+    unsigned int generation;
+} ProductHandle;
+
+// Open-addressing bucket of the productId index
+typedef struct
+{
+    int productId; // DELETED_PRODUCT_ID marks an empty bucket
+    int slot;
+} IdBucket;
+
+typedef struct
+{
+    float price;
+    int productId; // negated once removed
+} PriceEntry;
+
+// Prices in one sorted run plus a buffer of recent inserts. The buffer is
+// merged into the run once it outgrows PRICE_MERGE_MIN and 1/PRICE_MERGE_SHARE
+// of it; removals leave tombstones that the merge drops.
+typedef struct
+{
+    PriceEntry *sorted;
+    int sortedCount;
+    int sortedCapacity;
+    int removedCount;  // tombstones in either half
+    PriceEntry *pending;
+    int pendingCount;
+    int pendingSorted; // length of the sorted prefix of pending
+    int pendingCapacity;
+    bool fixedRun;     // sorted lives in the inventory file and cannot be reallocated
+} PriceIndex;
+
+// Position of a price range query in both halves of the index
+typedef struct
+{
+    int sortedNext, sortedEnd;
+    int pendingNext, pendingEnd;
+} PriceCursor;
+
+// Product IDs whose names contain one trigram
+typedef struct
+{
+    unsigned int trigram; // 0 marks an empty bucket
+    int count;            // postings, including ones of deleted products
+    int lastId;           // last ID delta-encoded into bytes
+    unsigned char *bytes; // ascending IDs as varint deltas
+    int byteCount, byteCapacity;
+    int *tail;            // IDs that arrived out of order
+    int tailCount, tailCapacity;
+} PostingList;
+
+// Trigram inverted index over product names, open addressing on the trigram
+typedef struct
+{
+    PostingList *lists;
+    unsigned int listMask;
+    int listCount;
+    long long postingCount;
+    long long staleCount; // postings of deleted products, dropped by a rebuild
+    bool disabled;        // ran out of memory, name searches scan instead
+    bool deferred;        // not built yet, the first name search builds it
+} NameIndex;
+
+// First bytes of an inventory file. The header page is followed by
+// capacity product slots, 2 * capacity ID buckets and capacity price
+// entries, all used in place through one shared mapping.
+typedef struct
+{
+    char magic[8];
+    unsigned int version;
+    unsigned int productSize;
+    int capacity;
+    int slotCount;
+    int productCount;
+    int priceCount; // entries in the sorted price run
+    int clean;      // 0 while open; the indexes are rebuilt if still 0 on open
+} InventoryFileHeader;
+
+typedef struct
+{
+    int fd;
+    unsigned char *map; // NULL when the inventory lives only in memory
+    size_t mapSize;
+    InventoryFileHeader *header;
+} InventoryFile;
+
+typedef struct
+{
+    Product product;
+    int line;
+} ImportRow;
+
+typedef struct
+{
+    int line;
+    const char *reason;
+} ImportError;
+
+// One thread's share of a CSV import: whole lines from start to end
+typedef struct
+{
+    const char *start, *end;
+    int lineCount;
+    ImportRow *rows;
+    int rowCount, rowCapacity;
+    ImportError *errors;
+    int errorCount, errorCapacity;
+    bool failed; // ran out of memory
+} ImportChunk;
+
+// Products are kept in insertion order. Deleting one leaves a tombstone in
+// its slot; the slots are compacted once tombstones make up half of them.
+typedef struct
+{
+    Product *products;
+    int *slotHandles;                // handle owning each slot plus one, 0 before one is asked for
+    int *handleSlots;                // slot of each live handle, next free handle otherwise
+    unsigned int *handleGenerations; // bumped on delete so old handles go stale
+    int capacity;
+    int slotCount;                   // used slots, tombstones included
+    int productCount;                // live products
+    int handleCount;
+    int freeHandle;                  // head of the free handle list, -1 when empty
+    IdBucket *idBuckets;             // productId -> slot, linear probing, 2 * capacity buckets
+    unsigned int idBucketMask;
+    PriceIndex prices;
+    NameIndex names;
+    InventoryFile file;
+} Inventory;
+
+// Stock of one product while order threads run; quantity changes never
+// take a lock
+typedef struct
+{
+    int productId;
+    _Atomic int quantity;
+} StockItem;
+
+typedef struct
+{
+    int productId;
+    StockItem *item; // NULL marks an empty bucket
+} StockBucket;
+
+// Never changed once published: writers build a new table and swap it in
+typedef struct
+{
+    unsigned int bucketMask;
+    int itemCount;
+    StockBucket buckets[];
+} StockTable;
+
+// Epoch a reader entered its read section in, 0 outside of one; padded so
+// readers do not share cache lines. casRetries is only written by the
+// thread holding the slot and survives the slot being handed on.
+typedef struct
+{
+    _Atomic unsigned long epoch;
+    long long casRetries;
+    _Atomic bool used;
+    char padding[64 - sizeof(unsigned long) - sizeof(long long) - sizeof(_Atomic bool)];
+} StockReader;
+
+// Thread-safe view of an inventory for order processing. Quantities change
+// by compare-and-swap; adding or removing a product copies the table under
+// writerLock, publishes the copy, and frees the old one after every reader
+// that could still see it has moved on.
+typedef struct
+{
+    Inventory *inventory; // only touched by writers while this is running
+    _Atomic(StockTable *) table;
+    _Atomic unsigned long epoch;
+    StockReader readers[MAX_STOCK_READERS];
+    pthread_mutex_t writerLock;
+    int tableSwaps;
+} ConcurrentInventory;
+
+typedef struct
+{
+    ConcurrentInventory *stock;
+    int index;
+    bool structural; // adds and retires products instead of taking orders
+    bool draining;   // only takes from the hot SKUs, until each is empty
+    _Atomic bool *go; // set once every thread of the phase has started
+    long long taken[STRESS_PRODUCTS], restocked[STRESS_PRODUCTS];
+    long long orders, refused, negative, churned;
+} StressWorker;
+
+bool initInventory(Inventory *inventory, int capacity);
+bool reserveInventory(Inventory *inventory, int capacity);
+ProductHandle insertProduct(Inventory *inventory, const Product *product);
+void removeProductAt(Inventory *inventory, int slot);
+void compactInventory(Inventory *inventory);
+ProductHandle handleForSlot(Inventory *inventory, int slot);
+Product *productFromHandle(Inventory *inventory, ProductHandle handle);
+unsigned int hashProductId(int productId, unsigned int mask);
+bool isLiveSlot(Inventory *inventory, int slot);
+int findProductSlot(Inventory *inventory, int productId);
+bool resizeIdIndex(Inventory *inventory, size_t bucketCount);
+void indexProductId(Inventory *inventory, int productId, int slot);
+void unindexProductId(Inventory *inventory, int productId);
+int comparePriceEntries(const void *first, const void *second);
+int lowerBoundPrice(const PriceEntry *entries, int count, PriceEntry key);
+PriceEntry *findPriceEntry(PriceEntry *entries, int count, PriceEntry key);
+bool addPriceEntry(PriceIndex *index, float price, int productId);
+void removePriceEntry(PriceIndex *index, float price, int productId);
+void sortPendingPrices(PriceIndex *index);
+void mergePriceEntries(PriceIndex *index);
+bool priceMergeDue(const PriceIndex *index);
+bool setProductPrice(Inventory *inventory, int slot, float price);
+void openPriceRange(Inventory *inventory, float minPrice, float maxPrice, PriceCursor *cursor);
+Product *nextInPriceRange(Inventory *inventory, PriceCursor *cursor);
+unsigned int nameTrigram(const char *name);
+PostingList *findPostingList(NameIndex *index, unsigned int trigram, bool create);
+bool appendVarint(PostingList *list, unsigned int value);
+bool appendPosting(PostingList *list, int productId);
+int compareIds(const void *first, const void *second);
+int decodePostings(const PostingList *list, int *ids);
+bool reencodePostings(PostingList *list);
+bool indexProductName(NameIndex *index, const Product *product);
+void forgetProductName(NameIndex *index, const Product *product);
+void freeNameIndex(NameIndex *index);
+bool rebuildNameIndex(Inventory *inventory);
+int scanProductNames(Inventory *inventory, const char *text, int **matches);
+int searchProductNames(Inventory *inventory, const char *text, int **matches);
+double monotonicMilliseconds();
+void makeBenchmarkName(char *name);
+int runNameSearchBenchmark(int productCount);
+size_t inventoryFileLayout(int capacity, size_t *bucketOffset, size_t *priceOffset);
+void attachInventoryFile(Inventory *inventory, unsigned char *map, size_t size, int capacity);
+bool openInventoryFile(Inventory *inventory, const char *path);
+void recoverInventoryFile(Inventory *inventory);
+bool growInventoryFile(Inventory *inventory, int capacity);
+void syncInventoryHeader(Inventory *inventory);
+void closeInventoryFile(Inventory *inventory);
+bool parseCsvInt(const char *field, const char *end, int *value);
+bool parseCsvFloat(const char *field, const char *end, float *value);
+const char *parseCsvRow(const char *line, const char *end, Product *product);
+bool addImportError(ImportChunk *chunk, int line, const char *reason);
+void *parseCsvChunk(void *argument);
+int compareImportErrors(const void *first, const void *second);
+bool importCsvFile(Inventory *inventory, const char *path);
+bool startConcurrentInventory(ConcurrentInventory *stock, Inventory *inventory);
+void stopConcurrentInventory(ConcurrentInventory *stock);
+StockTable *allocateStockTable(int itemCount);
+void placeStockItem(StockTable *table, StockItem *item);
+StockItem *findStockItem(StockTable *table, int productId);
+void freeStockTable(StockTable *table, bool freeItems);
+int joinStockReaders(ConcurrentInventory *stock);
+void leaveStockReaders(ConcurrentInventory *stock, int reader);
+StockTable *enterStockRead(ConcurrentInventory *stock, int reader);
+void leaveStockRead(ConcurrentInventory *stock, int reader);
+void waitForStockReaders(ConcurrentInventory *stock);
+bool changeStock(ConcurrentInventory *stock, int reader, int productId, int delta, int *remaining);
+int readStock(ConcurrentInventory *stock, int reader, int productId);
+bool publishProduct(ConcurrentInventory *stock, const Product *product);
+bool retireProduct(ConcurrentInventory *stock, int productId);
+void *runStressThread(void *argument);
+int runStressPhase(ConcurrentInventory *stock, StressWorker *workers, pthread_t *threads, int threadCount,
+                   bool draining, double *elapsed);
+long long countStockRetries(const ConcurrentInventory *stock);
+int runStockStressTest(int threadCount);
+
+void addNewProduct(Inventory *inventory);
+void viewAllProducts(Inventory *inventory);
+void updateProductQuantity(Inventory *inventory);
+void searchProductById(Inventory *inventory);
+void searchProductByName(Inventory *inventory);
+void searchProductByPriceRange(Inventory *inventory);
+void updateProductPrice(Inventory *inventory);
+void importProductsFromCsv(Inventory *inventory);
+void deleteProductById(Inventory *inventory);
+void freeInventoryMemory(Inventory *inventory);
+bool checkIdExist(Inventory *inventory, int product_id);
 void clearInputBuffer();
 
-int main()
+int main(int argc, char *argv[])
+{
+    if (argc >= 2 && strcmp(argv[1], "--bench-search") == 0)
+    {
+        int productCount = argc >= 3 ? atoi(argv[2]) : 1000000;
+        if (productCount < 1 || productCount > MAX_PRODUCT_ID)
+        {
+            printf("Please give a product count between 1 and %d.\n", MAX_PRODUCT_ID);
+            return 1;
+        }
+        return runNameSearchBenchmark(productCount);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--stress") == 0)
+    {
+        int threadCount = argc >= 3 ? atoi(argv[2]) : STRESS_THREADS;
+        if (threadCount < 3 || threadCount > MAX_STOCK_READERS + 2)
+        {
+            printf("Please give a thread count between 3 and %d.\n", MAX_STOCK_READERS + 2);
+            return 1;
+        }
+        return runStockStressTest(threadCount);
+    }
+
+    Inventory inventory;
+    if (argc >= 3 && strcmp(argv[1], "--file") == 0)
+    {
+        double start = monotonicMilliseconds();
+        if (!openInventoryFile(&inventory, argv[2]))
+        {
+            printf("Could not open inventory file %s!\n", argv[2]);
+            return 1;
+        }
+        printf("Loaded %d products from %s in %.1f ms.\n", inventory.productCount, argv[2],
+               monotonicMilliseconds() - start);
+    }
+    else if (!initInventory(&inventory, 0))
+    {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+
+    int initial_totalProduct = 0;
+    char input_buffer[30];
+    char extraChar;
+
+    while (inventory.productCount == 0)
+    {
+        printf("Enter the initial number of products (1-100): ");
+        fgets(input_buffer, sizeof(input_buffer), stdin);
+        int scannedItems = sscanf(input_buffer, "%d %c", &initial_totalProduct, &extraChar);
+
+        if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
+            (initial_totalProduct >= 1 && initial_totalProduct <= 100))
+        {
+            break;
+        }
+        printf("Please enter a number between 1 and 100.\n");
+    }
+
+    if (!reserveInventory(&inventory, inventory.productCount + initial_totalProduct))
+    {
+        printf("Memory allocation failed!\n");
+        freeInventoryMemory(&inventory);
+        return 1;
+    }
+
+    for (int productNo = 0; productNo < initial_totalProduct; productNo++)
+    {
+        printf("\nEnter details for product %d:\n", productNo + 1);
+        char userInput[150];
+        char extraChar;
+        Product newProduct;
+
+        // Product ID
+        while (1)
+        {
+            printf("Product ID (1-%d): ", MAX_PRODUCT_ID);
+            int temp_id;
+            fgets(userInput, sizeof(userInput), stdin);
+            int scannedItems = sscanf(userInput, "%d %c", &temp_id, &extraChar);
+
+            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
+                (temp_id >= 1 && temp_id <= MAX_PRODUCT_ID))
+            {
+                if (checkIdExist(&inventory, temp_id))
+                {
+                    printf("Product with this ID already exists, Please use a unique ID.\n");
+                    continue;
+                }
+                newProduct.productId = temp_id;
+                break;
+            }
+            else
+                printf("Please enter a number between 1 and %d.\n", MAX_PRODUCT_ID);
+        }
+
+        // Product Name
+        while (1)
+        {
+            printf("Product Name: ");
+            fgets(newProduct.productName, sizeof(newProduct.productName), stdin);
+            newProduct.productName[strcspn(newProduct.productName, "\n")] = '\0';
+            if (strlen(newProduct.productName) >= 1 && strlen(newProduct.productName) <= 50)
+                break;
+            else
+                printf("Please enter a product name (1 to 50 characters): ");
+        }
+
+        // Product Price
+        while (1)
+        {
+            printf("Product Price: ");
+            fgets(userInput, sizeof(userInput), stdin);
+            int scannedItems = sscanf(userInput, "%f %c", &newProduct.productPrice, &extraChar);
+
+            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
+                (newProduct.productPrice >= 0 && newProduct.productPrice <= 100000))
+                break;
+            else
+                printf("Please enter a product price between 0 and 100000.\n");
+        }
+
+        // Quantity
+        while (1)
+        {
+            printf("Enter Quantity (0 - 1000000): ");
+            int newQuantity;
+            char buffer[50], extraChar;
+            fgets(buffer, sizeof(buffer), stdin);
+            int scannedItems = sscanf(buffer, "%d %c", &newQuantity, &extraChar);
+
+            if (scannedItems == 1 && newQuantity >= 0 && newQuantity <= 1000000)
+            {
+                newProduct.productQuantity = newQuantity;
+                break;
+            }
+            printf("Please enter a valid quantity between 0 and 1000000.\n");
+        }
+
+        // capacity was reserved up front, but the price index can still run out of memory
+        if (insertProduct(&inventory, &newProduct).index < 0)
+            printf("Memory allocation failed, product %d was not added!\n", productNo + 1);
+        else
+            printf("Product added successfully!\n");
+    }
+
+    int userChoice;
+    do
+    {
+        printf("\n========= INVENTORY MENU =========\n");
+        printf("1. Add New Product\n");
+        printf("2. View All Products\n");
+        printf("3. Update Quantity\n");
+        printf("4. Search Product by ID\n");
+        printf("5. Search Product by Name\n");
+        printf("6. Search Product by Price Range\n");
+        printf("7. Delete Product\n");
+        printf("8. Update Price\n");
+        printf("9. Import Products from CSV\n");
+        printf("10. Exit\n");
+
+        while (1)
+        {
+            printf("Enter your choice: ");
+            char buffer[30], extraChar;
+            fgets(buffer, sizeof(buffer), stdin);
+            int scannedItems = sscanf(buffer, "%d %c", &userChoice, &extraChar);
+            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
+                (userChoice >= 1 && userChoice <= 10))
+                break;
+            printf("Invalid input. Please enter a number between 1 and 10.\n");
+        }
+
+        switch (userChoice)
+        {
+        case 1:
+            addNewProduct(&inventory);
+            break;
+        case 2:
+            viewAllProducts(&inventory);
+            break;
+        case 3:
+            updateProductQuantity(&inventory);
+            break;
+        case 4:
+            searchProductById(&inventory);
+            break;
+        case 5:
+            searchProductByName(&inventory);
+            break;
+        case 6:
+            searchProductByPriceRange(&inventory);
+            break;
+        case 7:
+            deleteProductById(&inventory);
+            break;
+        case 8:
+            updateProductPrice(&inventory);
+            break;
+        case 9:
+            importProductsFromCsv(&inventory);
+            break;
+        case 10:
+            freeInventoryMemory(&inventory);
+            printf("Memory released successfully. Exiting program...\n");
+            break;
+        }
+    } while (userChoice != 10);
+
+    return 0;
+}
+
+bool initInventory(Inventory *inventory, int capacity)
+{
+    memset(inventory, 0, sizeof(*inventory));
+    inventory->freeHandle = -1;
+    return reserveInventory(inventory, capacity);
+}
+
+// Grow geometrically so that n inserts cost O(n) copying in total
+bool reserveInventory(Inventory *inventory, int capacity)
+{
+    if (capacity <= inventory->capacity)
+        return true;
+
+    size_t newCapacity = inventory->capacity > 0 ? (size_t)inventory->capacity : MIN_INVENTORY_CAPACITY;
+    while (newCapacity < (size_t)capacity)
+        newCapacity *= 2;
+
+    // Arrays that are merely longer than capacity stay consistent, so they
+    // grow first; the file remap or ID index rebuild that changes what the
+    // table looks like comes last, and capacity only once everything worked
+    int *slotHandles = (int *)realloc(inventory->slotHandles, newCapacity * sizeof(int));
+    if (slotHandles == NULL)
+        return false;
+    inventory->slotHandles = slotHandles;
+
+    int *handleSlots = (int *)realloc(inventory->handleSlots, newCapacity * sizeof(int));
+    if (handleSlots == NULL)
+        return false;
+    inventory->handleSlots = handleSlots;
+
+    unsigned int *handleGenerations = (unsigned int *)realloc(inventory->handleGenerations,
+                                                              newCapacity * sizeof(unsigned int));
+    if (handleGenerations == NULL)
+        return false;
+    inventory->handleGenerations = handleGenerations;
+
+    if (inventory->file.map != NULL)
+    {
+        if (!growInventoryFile(inventory, (int)newCapacity))
+            return false;
+    }
+    else
+    {
+        Product *products = (Product *)realloc(inventory->products, newCapacity * sizeof(Product));
+        if (products == NULL)
+            return false;
+        inventory->products = products;
+        if (!resizeIdIndex(inventory, 2 * newCapacity))
+            return false;
+    }
+    inventory->capacity = (int)newCapacity;
+    return true;
+}
+
+// Appends a copy of product; the returned handle has index -1 if memory ran out
+ProductHandle insertProduct(Inventory *inventory, const Product *product)
+{
+    ProductHandle handle = {-1, 0};
+    if (inventory->slotCount == inventory->capacity && !reserveInventory(inventory, inventory->slotCount + 1))
+        return handle;
+    if (!addPriceEntry(&inventory->prices, product->productPrice, product->productId))
+        return handle;
+
+    int slot = inventory->slotCount++;
+    inventory->products[slot] = *product;
+    inventory->slotHandles[slot] = 0;
+    inventory->productCount++;
+    indexProductId(inventory, product->productId, slot);
+    if (!inventory->names.disabled && !inventory->names.deferred && !indexProductName(&inventory->names, product))
+    {
+        freeNameIndex(&inventory->names);
+        inventory->names.disabled = true;
+    }
+    syncInventoryHeader(inventory);
+    return handleForSlot(inventory, slot);
+}
+
+// Products loaded from a file get their handles when first asked for
+ProductHandle handleForSlot(Inventory *inventory, int slot)
+{
+    ProductHandle handle;
+    int index = inventory->slotHandles[slot] - 1;
+    if (index < 0)
+    {
+        index = inventory->freeHandle;
+        if (index >= 0)
+            inventory->freeHandle = inventory->handleSlots[index];
+        else
+        {
+            index = inventory->handleCount++;
+            inventory->handleGenerations[index] = 0;
+        }
+        inventory->handleSlots[index] = slot;
+        inventory->slotHandles[slot] = index + 1;
+    }
+
+    handle.index = index;
+    handle.generation = inventory->handleGenerations[index];
+    return handle;
+}
+
+void removeProductAt(Inventory *inventory, int slot)
+{
+    int index = inventory->slotHandles[slot] - 1;
+    unindexProductId(inventory, inventory->products[slot].productId);
+    removePriceEntry(&inventory->prices, inventory->products[slot].productPrice, inventory->products[slot].productId);
+    forgetProductName(&inventory->names, &inventory->products[slot]);
+    inventory->products[slot].productId = DELETED_PRODUCT_ID;
+    if (index >= 0)
+    {
+        inventory->handleGenerations[index]++;
+        inventory->handleSlots[index] = inventory->freeHandle;
+        inventory->freeHandle = index;
+    }
+    inventory->productCount--;
+
+    // Tombstones at the end can simply be dropped
+    while (inventory->slotCount > 0 &&
+           inventory->products[inventory->slotCount - 1].productId == DELETED_PRODUCT_ID)
+        inventory->slotCount--;
+
+    if (inventory->slotCount - inventory->productCount > inventory->slotCount / 2)
+        compactInventory(inventory);
+    if (!inventory->names.disabled && !inventory->names.deferred &&
+        inventory->names.staleCount > inventory->names.postingCount / 2)
+        rebuildNameIndex(inventory);
+    syncInventoryHeader(inventory);
+}
+
+// Slide live products over the tombstones, keeping their order
+void compactInventory(Inventory *inventory)
+{
+    int liveSlot = 0;
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (inventory->products[slot].productId == DELETED_PRODUCT_ID)
+            continue;
+        if (liveSlot != slot)
+        {
+            inventory->products[liveSlot] = inventory->products[slot];
+            inventory->slotHandles[liveSlot] = inventory->slotHandles[slot];
+            if (inventory->slotHandles[liveSlot] > 0)
+                inventory->handleSlots[inventory->slotHandles[liveSlot] - 1] = liveSlot;
+            indexProductId(inventory, inventory->products[liveSlot].productId, liveSlot);
+        }
+        liveSlot++;
+    }
+    inventory->slotCount = liveSlot;
+}
+
+Product *productFromHandle(Inventory *inventory, ProductHandle handle)
+{
+    if (handle.index < 0 || handle.index >= inventory->handleCount ||
+        inventory->handleGenerations[handle.index] != handle.generation)
+        return NULL;
+    return &inventory->products[inventory->handleSlots[handle.index]];
+}
+
+bool isLiveSlot(Inventory *inventory, int slot)
+{
+    return inventory->products[slot].productId != DELETED_PRODUCT_ID;
+}
+
+// Fibonacci hashing spreads consecutive IDs across the table
+unsigned int hashProductId(int productId, unsigned int mask)
+{
+    return (unsigned int)(((unsigned long long)(unsigned int)productId * 11400714819323198485ull) >> 32) & mask;
+}
+
+int findProductSlot(Inventory *inventory, int productId)
+{
+    if (productId == DELETED_PRODUCT_ID || inventory->idBuckets == NULL)
+        return -1;
+    unsigned int mask = inventory->idBucketMask;
+    for (unsigned int bucket = hashProductId(productId, mask);; bucket = (bucket + 1) & mask)
+    {
+        if (inventory->idBuckets[bucket].productId == productId)
+            return inventory->idBuckets[bucket].slot;
+        if (inventory->idBuckets[bucket].productId == DELETED_PRODUCT_ID)
+            return -1;
+    }
+}
+
+// Adds productId, or moves it to slot if it is already indexed
+void indexProductId(Inventory *inventory, int productId, int slot)
+{
+    unsigned int mask = inventory->idBucketMask;
+    unsigned int bucket = hashProductId(productId, mask);
+    while (inventory->idBuckets[bucket].productId != DELETED_PRODUCT_ID &&
+           inventory->idBuckets[bucket].productId != productId)
+        bucket = (bucket + 1) & mask;
+    inventory->idBuckets[bucket].productId = productId;
+    inventory->idBuckets[bucket].slot = slot;
+}
+
+// Backward-shift deletion, so lookups never have to skip deleted buckets
+void unindexProductId(Inventory *inventory, int productId)
+{
+    unsigned int mask = inventory->idBucketMask;
+    unsigned int hole = hashProductId(productId, mask);
+    while (inventory->idBuckets[hole].productId != productId)
+    {
+        if (inventory->idBuckets[hole].productId == DELETED_PRODUCT_ID)
+            return;
+        hole = (hole + 1) & mask;
+    }
+
+    for (unsigned int next = (hole + 1) & mask; inventory->idBuckets[next].productId != DELETED_PRODUCT_ID;
+         next = (next + 1) & mask)
+    {
+        unsigned int home = hashProductId(inventory->idBuckets[next].productId, mask);
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            inventory->idBuckets[hole] = inventory->idBuckets[next];
+            hole = next;
+        }
+    }
+    inventory->idBuckets[hole].productId = DELETED_PRODUCT_ID;
+}
+
+// bucketCount must be a power of two larger than the number of products
+bool resizeIdIndex(Inventory *inventory, size_t bucketCount)
+{
+    IdBucket *buckets = (IdBucket *)calloc(bucketCount, sizeof(IdBucket));
+    if (buckets == NULL)
+        return false;
+
+    free(inventory->idBuckets);
+    inventory->idBuckets = buckets;
+    inventory->idBucketMask = (unsigned int)(bucketCount - 1);
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (isLiveSlot(inventory, slot))
+            indexProductId(inventory, inventory->products[slot].productId, slot);
+    }
+    return true;
+}
+
+// Orders by price, then by ID; removed entries keep their place
+int comparePriceEntries(const void *first, const void *second)
+{
+    const PriceEntry *a = (const PriceEntry *)first, *b = (const PriceEntry *)second;
+    if (a->price != b->price)
+        return a->price < b->price ? -1 : 1;
+    int idA = abs(a->productId), idB = abs(b->productId);
+    return (idA > idB) - (idA < idB);
+}
+
+// First entry not ordered before key
+int lowerBoundPrice(const PriceEntry *entries, int count, PriceEntry key)
+{
+    int low = 0, high = count;
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        if (comparePriceEntries(&entries[middle], &key) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+// Only fails when memory runs out, and then leaves the index unchanged
+bool addPriceEntry(PriceIndex *index, float price, int productId)
+{
+    if (index->pendingCount == index->pendingCapacity)
+    {
+        int newCapacity = index->pendingCapacity > 0 ? 2 * index->pendingCapacity : PRICE_MERGE_MIN;
+        PriceEntry *pending = (PriceEntry *)realloc(index->pending, (size_t)newCapacity * sizeof(PriceEntry));
+        if (pending == NULL)
+            return false;
+        index->pending = pending;
+        index->pendingCapacity = newCapacity;
+    }
+
+    index->pending[index->pendingCount].price = price;
+    index->pending[index->pendingCount].productId = productId;
+    index->pendingCount++;
+
+    if (priceMergeDue(index))
+        mergePriceEntries(index);
+    return true;
+}
+
+bool priceMergeDue(const PriceIndex *index)
+{
+    return index->pendingCount > PRICE_MERGE_MIN && index->pendingCount > index->sortedCount / PRICE_MERGE_SHARE;
+}
+
+// Live entry matching key, skipping tombstones of the same product
+PriceEntry *findPriceEntry(PriceEntry *entries, int count, PriceEntry key)
+{
+    for (int at = lowerBoundPrice(entries, count, key);
+         at < count && comparePriceEntries(&entries[at], &key) == 0; at++)
+    {
+        if (entries[at].productId == key.productId)
+            return &entries[at];
+    }
+    return NULL;
+}
+
+// Tombstones the entry; the merge that drops it also runs once a quarter
+// of all entries are tombstones
+void removePriceEntry(PriceIndex *index, float price, int productId)
+{
+    PriceEntry key = {price, productId};
+
+    sortPendingPrices(index);
+    PriceEntry *entry = findPriceEntry(index->pending, index->pendingCount, key);
+    if (entry == NULL)
+        entry = findPriceEntry(index->sorted, index->sortedCount, key);
+    if (entry == NULL)
+        return;
+
+    entry->productId = -productId;
+    index->removedCount++;
+    if (index->removedCount > (index->sortedCount + index->pendingCount) / 4)
+        mergePriceEntries(index);
+}
+
+// Recent inserts are usually few, so insertion sort them into place
+void sortPendingPrices(PriceIndex *index)
+{
+    if (index->pendingCount - index->pendingSorted > 16)
+        qsort(index->pending, index->pendingCount, sizeof(PriceEntry), comparePriceEntries);
+    else
+    {
+        for (int i = index->pendingSorted; i < index->pendingCount; i++)
+        {
+            PriceEntry entry = index->pending[i];
+            int j = i;
+            for (; j > 0 && comparePriceEntries(&index->pending[j - 1], &entry) > 0; j--)
+                index->pending[j] = index->pending[j - 1];
+            index->pending[j] = entry;
+        }
+    }
+    index->pendingSorted = index->pendingCount;
+}
+
+// Drop tombstones, then merge the pending entries into the sorted run from
+// the back. If the run cannot grow, the entries just stay pending. A run in
+// the inventory file has room for every slot but can briefly be one short:
+// setProductPrice adds the new entry before it removes the old one.
+void mergePriceEntries(PriceIndex *index)
+{
+    int total = index->sortedCount + index->pendingCount - index->removedCount;
+    if (total > index->sortedCapacity)
+    {
+        if (index->fixedRun)
+            return;
+        int newCapacity = total > 2 * index->sortedCapacity ? total : 2 * index->sortedCapacity;
+        PriceEntry *sorted = (PriceEntry *)realloc(index->sorted, (size_t)newCapacity * sizeof(PriceEntry));
+        if (sorted == NULL)
+            return;
+        index->sorted = sorted;
+        index->sortedCapacity = newCapacity;
+    }
+
+    int kept = 0, keptPending = 0;
+    for (int i = 0; i < index->sortedCount; i++)
+    {
+        if (index->sorted[i].productId > 0)
+            index->sorted[kept++] = index->sorted[i];
+    }
+    sortPendingPrices(index);
+    for (int i = 0; i < index->pendingCount; i++)
+    {
+        if (index->pending[i].productId > 0)
+            index->pending[keptPending++] = index->pending[i];
+    }
+
+    int fromSorted = kept - 1, fromPending = keptPending - 1;
+    for (int out = total - 1; fromPending >= 0; out--)
+    {
+        if (fromSorted >= 0 && comparePriceEntries(&index->sorted[fromSorted], &index->pending[fromPending]) > 0)
+            index->sorted[out] = index->sorted[fromSorted--];
+        else
+            index->sorted[out] = index->pending[fromPending--];
+    }
+
+    index->sortedCount = total;
+    index->removedCount = 0;
+    index->pendingCount = index->pendingSorted = 0;
+}
+
+bool setProductPrice(Inventory *inventory, int slot, float price)
+{
+    Product *product = &inventory->products[slot];
+    if (!addPriceEntry(&inventory->prices, price, product->productId))
+        return false;
+    removePriceEntry(&inventory->prices, product->productPrice, product->productId);
+    product->productPrice = price;
+    // A full run in the inventory file skipped the merge until the old entry went
+    if (priceMergeDue(&inventory->prices))
+        mergePriceEntries(&inventory->prices);
+    return true;
+}
+
+// Products priced within [minPrice, maxPrice] come back from
+// nextInPriceRange in price order; the inventory must not change meanwhile
+void openPriceRange(Inventory *inventory, float minPrice, float maxPrice, PriceCursor *cursor)
+{
+    PriceIndex *index = &inventory->prices;
+    PriceEntry first = {minPrice, 0}, last = {maxPrice, MAX_PRODUCT_ID + 1};
+
+    sortPendingPrices(index);
+    cursor->sortedNext = lowerBoundPrice(index->sorted, index->sortedCount, first);
+    cursor->sortedEnd = lowerBoundPrice(index->sorted, index->sortedCount, last);
+    cursor->pendingNext = lowerBoundPrice(index->pending, index->pendingCount, first);
+    cursor->pendingEnd = lowerBoundPrice(index->pending, index->pendingCount, last);
+}
+
+Product *nextInPriceRange(Inventory *inventory, PriceCursor *cursor)
+{
+    PriceIndex *index = &inventory->prices;
+    while (cursor->sortedNext < cursor->sortedEnd && index->sorted[cursor->sortedNext].productId < 0)
+        cursor->sortedNext++;
+    while (cursor->pendingNext < cursor->pendingEnd && index->pending[cursor->pendingNext].productId < 0)
+        cursor->pendingNext++;
+
+    PriceEntry *entry;
+    if (cursor->sortedNext < cursor->sortedEnd &&
+        (cursor->pendingNext == cursor->pendingEnd ||
+         comparePriceEntries(&index->sorted[cursor->sortedNext], &index->pending[cursor->pendingNext]) < 0))
+        entry = &index->sorted[cursor->sortedNext++];
+    else if (cursor->pendingNext < cursor->pendingEnd)
+        entry = &index->pending[cursor->pendingNext++];
+    else
+        return NULL;
+    return &inventory->products[findProductSlot(inventory, entry->productId)];
+}
+
+// Three name bytes packed into one key; never 0 inside a C string
+unsigned int nameTrigram(const char *name)
+{
+    const unsigned char *bytes = (const unsigned char *)name;
+    return (unsigned int)bytes[0] << 16 | (unsigned int)bytes[1] << 8 | bytes[2];
+}
+
+// Finds the list for trigram, adding an empty one when create is set
+PostingList *findPostingList(NameIndex *index, unsigned int trigram, bool create)
+{
+    if (index->lists == NULL)
+    {
+        if (!create)
+            return NULL;
+        index->lists = (PostingList *)calloc(NAME_LISTS_MIN, sizeof(PostingList));
+        if (index->lists == NULL)
+            return NULL;
+        index->listMask = NAME_LISTS_MIN - 1;
+    }
+
+    unsigned int bucket = hashProductId((int)trigram, index->listMask);
+    while (index->lists[bucket].trigram != 0)
+    {
+        if (index->lists[bucket].trigram == trigram)
+            return &index->lists[bucket];
+        bucket = (bucket + 1) & index->listMask;
+    }
+    if (!create)
+        return NULL;
+
+    if (2 * (index->listCount + 1) > (int)index->listMask + 1)
+    {
+        unsigned int newMask = 2 * index->listMask + 1;
+        PostingList *lists = (PostingList *)calloc((size_t)newMask + 1, sizeof(PostingList));
+        if (lists == NULL)
+            return NULL;
+        for (unsigned int old = 0; old <= index->listMask; old++)
+        {
+            if (index->lists[old].trigram == 0)
+                continue;
+            unsigned int moved = hashProductId((int)index->lists[old].trigram, newMask);
+            while (lists[moved].trigram != 0)
+                moved = (moved + 1) & newMask;
+            lists[moved] = index->lists[old];
+        }
+        free(index->lists);
+        index->lists = lists;
+        index->listMask = newMask;
+
+        bucket = hashProductId((int)trigram, newMask);
+        while (index->lists[bucket].trigram != 0)
+            bucket = (bucket + 1) & newMask;
+    }
+
+    index->listCount++;
+    index->lists[bucket].trigram = trigram;
+    index->lists[bucket].lastId = 0;
+    return &index->lists[bucket];
+}
+
+bool appendVarint(PostingList *list, unsigned int value)
+{
+    if (list->byteCount + 5 > list->byteCapacity)
+    {
+        int newCapacity = list->byteCapacity > 0 ? 2 * list->byteCapacity : 16;
+        unsigned char *bytes = (unsigned char *)realloc(list->bytes, (size_t)newCapacity);
+        if (bytes == NULL)
+            return false;
+        list->bytes = bytes;
+        list->byteCapacity = newCapacity;
+    }
+    while (value >= 0x80)
+    {
+        list->bytes[list->byteCount++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    list->bytes[list->byteCount++] = (unsigned char)value;
+    return true;
+}
+
+// IDs arriving in ascending order are delta-encoded straight away; the rest
+// wait in the tail until the list is re-encoded
+bool appendPosting(PostingList *list, int productId)
+{
+    if (productId > list->lastId)
+    {
+        if (!appendVarint(list, (unsigned int)(productId - list->lastId)))
+            return false;
+        list->lastId = productId;
+    }
+    else if (productId == list->lastId || (list->tailCount > 0 && list->tail[list->tailCount - 1] == productId))
+        return true;
+    else
+    {
+        if (list->tailCount == list->tailCapacity)
+        {
+            int newCapacity = list->tailCapacity > 0 ? 2 * list->tailCapacity : 4;
+            int *tail = (int *)realloc(list->tail, (size_t)newCapacity * sizeof(int));
+            if (tail == NULL)
+                return false;
+            list->tail = tail;
+            list->tailCapacity = newCapacity;
+        }
+        list->tail[list->tailCount++] = productId;
+    }
+    list->count++;
+
+    if (list->tailCount > NAME_TAIL_MIN && list->tailCount > list->count / 8)
+        return reencodePostings(list);
+    return true;
+}
+
+int compareIds(const void *first, const void *second)
+{
+    int a = *(const int *)first, b = *(const int *)second;
+    return (a > b) - (a < b);
+}
+
+// Writes the list's distinct IDs in ascending order to ids, which must hold
+// list->count entries, and returns how many there are
+int decodePostings(const PostingList *list, int *ids)
+{
+    int count = 0, productId = 0;
+    for (int at = 0; at < list->byteCount;)
+    {
+        unsigned int delta = 0;
+        int shift = 0;
+        unsigned char byte;
+        do
+        {
+            byte = list->bytes[at++];
+            delta |= (unsigned int)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        productId += (int)delta;
+        ids[count++] = productId;
+    }
+
+    if (list->tailCount > 0)
+    {
+        memcpy(&ids[count], list->tail, (size_t)list->tailCount * sizeof(int));
+        count += list->tailCount;
+        qsort(ids, count, sizeof(int), compareIds);
+
+        int unique = 1;
+        for (int i = 1; i < count; i++)
+        {
+            if (ids[i] != ids[unique - 1])
+                ids[unique++] = ids[i];
+        }
+        count = unique;
+    }
+    return count;
+}
+
+// Folds the tail into the delta-encoded bytes
+bool reencodePostings(PostingList *list)
+{
+    int *ids = (int *)malloc((size_t)list->count * sizeof(int));
+    unsigned char *bytes = (unsigned char *)malloc((size_t)list->count * 5);
+    if (ids == NULL || bytes == NULL)
+    {
+        free(ids);
+        free(bytes);
+        return false;
+    }
+    int count = decodePostings(list, ids);
+
+    free(list->bytes);
+    list->bytes = bytes;
+    list->byteCapacity = list->count * 5; // room for every ID as a full varint
+    list->byteCount = list->tailCount = list->count = 0;
+    list->lastId = 0;
+    for (int i = 0; i < count; i++)
+        appendPosting(list, ids[i]);
+    free(ids);
+    return true;
+}
+
+bool indexProductName(NameIndex *index, const Product *product)
+{
+    int length = (int)strlen(product->productName);
+    for (int at = 0; at + 3 <= length; at++)
+    {
+        PostingList *list = findPostingList(index, nameTrigram(&product->productName[at]), true);
+        if (list == NULL)
+            return false;
+        int before = list->count;
+        if (!appendPosting(list, product->productId))
+            return false;
+        index->postingCount += list->count - before;
+    }
+    return true;
+}
+
+// Postings of deleted products stay behind until the next rebuild; the
+// searches verify every candidate against the live product anyway
+void forgetProductName(NameIndex *index, const Product *product)
+{
+    int length = (int)strlen(product->productName);
+    if (length >= 3)
+        index->staleCount += length - 2;
+}
+
+void freeNameIndex(NameIndex *index)
+{
+    if (index->lists != NULL)
+    {
+        for (unsigned int bucket = 0; bucket <= index->listMask; bucket++)
+        {
+            free(index->lists[bucket].bytes);
+            free(index->lists[bucket].tail);
+        }
+    }
+    free(index->lists);
+    memset(index, 0, sizeof(*index));
+}
+
+// Without the memory for the index, name searches fall back to a scan
+bool rebuildNameIndex(Inventory *inventory)
+{
+    NameIndex *index = &inventory->names;
+    freeNameIndex(index);
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (isLiveSlot(inventory, slot) && !indexProductName(index, &inventory->products[slot]))
+        {
+            freeNameIndex(index);
+            index->disabled = true;
+            return false;
+        }
+    }
+    for (unsigned int bucket = 0; index->lists != NULL && bucket <= index->listMask; bucket++)
+    {
+        if (index->lists[bucket].tailCount > 0)
+            reencodePostings(&index->lists[bucket]);
+    }
+    return true;
+}
+
+// The straightforward search: every live product name with strstr
+int scanProductNames(Inventory *inventory, const char *text, int **matches)
+{
+    int count = 0;
+    *matches = (int *)malloc((size_t)(inventory->productCount > 0 ? inventory->productCount : 1) * sizeof(int));
+    if (*matches == NULL)
+        return -1;
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (isLiveSlot(inventory, slot) && strstr(inventory->products[slot].productName, text) != NULL)
+            (*matches)[count++] = slot;
+    }
+    return count;
+}
+
+// Slots, in listing order, of the products whose names contain text. The
+// rarest trigrams of text give the candidates, which are then checked with
+// strstr. Returns -1 if memory runs out; the caller frees *matches.
+int searchProductNames(Inventory *inventory, const char *text, int **matches)
+{
+    NameIndex *index = &inventory->names;
+    int length = (int)strlen(text);
+    if (length >= 3 && index->deferred)
+        rebuildNameIndex(inventory);
+    if (length < 3 || index->disabled)
+        return scanProductNames(inventory, text, matches);
+
+    PostingList *lists[MAX_NAME_LENGTH];
+    int listCount = 0;
+    for (int at = 0; at + 3 <= length; at++)
+    {
+        PostingList *list = findPostingList(index, nameTrigram(&text[at]), false);
+        if (list == NULL)
+        {
+            *matches = NULL;
+            return 0;
+        }
+        int insertAt = listCount++;
+        for (; insertAt > 0 && lists[insertAt - 1]->count > list->count; insertAt--)
+            lists[insertAt] = lists[insertAt - 1];
+        lists[insertAt] = list;
+    }
+
+    *matches = (int *)malloc((size_t)lists[0]->count * sizeof(int));
+    if (*matches == NULL)
+        return -1;
+    int candidates = decodePostings(lists[0], *matches);
+
+    // Intersecting with the next lists is cheaper than a lookup per
+    // candidate while they are not much longer than the candidate list
+    int *ids = NULL;
+    for (int next = 1; next < listCount && candidates > 0 && lists[next]->count <= 8 * candidates; next++)
+    {
+        if (lists[next] == lists[next - 1])
+            continue;
+        int *grown = (int *)realloc(ids, (size_t)lists[next]->count * sizeof(int));
+        if (grown == NULL)
+            break;
+        ids = grown;
+        int idCount = decodePostings(lists[next], ids), kept = 0;
+        for (int i = 0, j = 0; i < candidates && j < idCount;)
+        {
+            if ((*matches)[i] < ids[j])
+                i++;
+            else if ((*matches)[i] > ids[j])
+                j++;
+            else
+            {
+                (*matches)[kept++] = (*matches)[i];
+                i++;
+                j++;
+            }
+        }
+        candidates = kept;
+    }
+    free(ids);
+
+    int count = 0;
+    for (int i = 0; i < candidates; i++)
+    {
+        int slot = findProductSlot(inventory, (*matches)[i]);
+        if (slot >= 0 && strstr(inventory->products[slot].productName, text) != NULL)
+            (*matches)[count++] = slot;
+    }
+    qsort(*matches, count, sizeof(int), compareIds);
+    return count;
+}
+
+double monotonicMilliseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+// Random names built from syllables, so that substrings repeat the way
+// words do in a real catalog
+void makeBenchmarkName(char *name)
+{
+    static const char *syllables[] = {"ka", "lo", "mi", "ne", "ru", "sa", "ti", "vo", "zen", "bar",
+                                      "dor", "fil", "gra", "hex", "jun", "kor", "lum", "mox", "nit",
+                                      "pra", "qua", "ros", "sul", "tor", "ux", "vel", "wim", "yar",
+                                      "bel", "cat", "dex", "eon", "fyr", "gol", "hal", "ist", "jak",
+                                      "ker", "lin", "mur", "nox", "orb", "pel", "rix", "sto", "tul",
+                                      "umb", "vex", "wol", "xen", "yth", "zor", "ash", "bro", "cy"};
+    int syllableCount = sizeof(syllables) / sizeof(syllables[0]);
+    int words = 2 + rand() % 3;
+    name[0] = '\0';
+    for (int word = 0; word < words; word++)
+    {
+        if (word > 0)
+            strcat(name, " ");
+        for (int part = 1 + rand() % 3; part > 0; part--)
+            strcat(name, syllables[rand() % syllableCount]);
+    }
+    sprintf(name + strlen(name), " %d", rand() % 10000);
+}
+
+// --bench-search N: fills an inventory with N generated products, then
+// times substring searches through the trigram index and by scanning,
+// checking that both return the same products
+int runNameSearchBenchmark(int productCount)
+{
+    Inventory inventory;
+    if (!initInventory(&inventory, productCount))
+    {
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+
+    srand(12345);
+    double start = monotonicMilliseconds();
+    for (int productId = 1; productId <= productCount; productId++)
+    {
+        Product product = {productId, "", (float)(rand() % 10000000) / 100, rand() % 1000};
+        makeBenchmarkName(product.productName);
+        insertProduct(&inventory, &product);
+    }
+    printf("Loaded %d products in %.1f ms (%d trigram lists, %lld postings%s)\n", productCount,
+           monotonicMilliseconds() - start, inventory.names.listCount, inventory.names.postingCount,
+           inventory.names.disabled ? ", index disabled" : "");
+
+    int queries = 200, mismatches = 0;
+    long long found = 0;
+    double indexedTime = 0, scanTime = 0;
+    for (int query = 0; query < queries; query++)
+    {
+        char text[MAX_NAME_LENGTH];
+        const char *name = inventory.products[rand() % inventory.slotCount].productName;
+        int length = 4 + rand() % 5, nameLength = (int)strlen(name);
+        if (length > nameLength)
+            length = nameLength;
+        int from = rand() % (nameLength - length + 1);
+        memcpy(text, &name[from], length);
+        text[length] = '\0';
+
+        int *indexed, *scanned;
+        start = monotonicMilliseconds();
+        int indexedCount = searchProductNames(&inventory, text, &indexed);
+        indexedTime += monotonicMilliseconds() - start;
+        start = monotonicMilliseconds();
+        int scannedCount = scanProductNames(&inventory, text, &scanned);
+        scanTime += monotonicMilliseconds() - start;
+
+        if (indexedCount != scannedCount ||
+            (indexedCount > 0 && memcmp(indexed, scanned, (size_t)indexedCount * sizeof(int)) != 0))
+        {
+            printf("Mismatch for '%s': %d indexed vs %d scanned results\n", text, indexedCount, scannedCount);
+            mismatches++;
+        }
+        found += scannedCount;
+        free(indexed);
+        free(scanned);
+    }
+
+    printf("%d searches, %.1f results each: index %.3f ms/search, scan %.3f ms/search (%.1fx)\n", queries,
+           (double)found / queries, indexedTime / queries, scanTime / queries,
+           indexedTime > 0 ? scanTime / indexedTime : 0);
+    freeInventoryMemory(&inventory);
+    if (mismatches > 0)
+    {
+        printf("%d searches returned different results!\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
+
+// Byte offsets of the index sections for a file holding capacity products;
+// returns the file size
+size_t inventoryFileLayout(int capacity, size_t *bucketOffset, size_t *priceOffset)
+{
+    *bucketOffset = INVENTORY_FILE_HEADER + (size_t)capacity * sizeof(Product);
+    *priceOffset = *bucketOffset + 2 * (size_t)capacity * sizeof(IdBucket);
+    return *priceOffset + (size_t)capacity * sizeof(PriceEntry);
+}
+
+// Point the table and indexes at their sections of a fresh mapping
+void attachInventoryFile(Inventory *inventory, unsigned char *map, size_t size, int capacity)
+{
+    size_t bucketOffset, priceOffset;
+    inventoryFileLayout(capacity, &bucketOffset, &priceOffset);
+
+    inventory->file.map = map;
+    inventory->file.mapSize = size;
+    inventory->file.header = (InventoryFileHeader *)map;
+    inventory->products = (Product *)(map + INVENTORY_FILE_HEADER);
+    inventory->idBuckets = (IdBucket *)(map + bucketOffset);
+    inventory->idBucketMask = (unsigned int)(2 * capacity - 1);
+    inventory->prices.sorted = (PriceEntry *)(map + priceOffset);
+    inventory->prices.sortedCapacity = capacity; // the run never holds more entries than slots
+    inventory->prices.fixedRun = true;
+}
+
+// Opens or creates the inventory file at path and maps it. A file that was
+// not closed cleanly gets its indexes rebuilt from the products; otherwise
+// nothing is read up front, pages load as the products are used. The name
+// index is not stored and is built by the first name search.
+bool openInventoryFile(Inventory *inventory, const char *path)
+{
+    if (!initInventory(inventory, 0))
+        return false;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    InventoryFileHeader header;
+    size_t bucketOffset, priceOffset, size;
+    bool fresh = fstat(fd, &info) == 0 && info.st_size == 0;
+    if (fresh)
+    {
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, INVENTORY_FILE_MAGIC, sizeof(header.magic));
+        header.version = INVENTORY_FILE_VERSION;
+        header.productSize = sizeof(Product);
+        header.capacity = MIN_INVENTORY_CAPACITY;
+        header.clean = 1;
+        size = inventoryFileLayout(header.capacity, &bucketOffset, &priceOffset);
+        if (ftruncate(fd, (off_t)size) != 0 || pwrite(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+        {
+            close(fd);
+            return false;
+        }
+    }
+    else
+    {
+        if (pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header) ||
+            memcmp(header.magic, INVENTORY_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != INVENTORY_FILE_VERSION || header.productSize != sizeof(Product) ||
+            header.capacity < MIN_INVENTORY_CAPACITY || (header.capacity & (header.capacity - 1)) != 0 ||
+            header.slotCount < 0 || header.slotCount > header.capacity ||
+            header.productCount < 0 || header.productCount > header.slotCount ||
+            header.priceCount < 0 || header.priceCount > header.capacity ||
+            (size_t)info.st_size < inventoryFileLayout(header.capacity, &bucketOffset, &priceOffset))
+        {
+            printf("%s is not an inventory file.\n", path);
+            close(fd);
+            return false;
+        }
+        size = inventoryFileLayout(header.capacity, &bucketOffset, &priceOffset);
+    }
+
+    unsigned char *map = (unsigned char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int *slotHandles = (int *)calloc((size_t)header.capacity, sizeof(int));
+    int *handleSlots = (int *)malloc((size_t)header.capacity * sizeof(int));
+    unsigned int *handleGenerations = (unsigned int *)malloc((size_t)header.capacity * sizeof(unsigned int));
+    if (map == MAP_FAILED || slotHandles == NULL || handleSlots == NULL || handleGenerations == NULL)
+    {
+        if (map != MAP_FAILED)
+            munmap(map, size);
+        free(slotHandles);
+        free(handleSlots);
+        free(handleGenerations);
+        close(fd);
+        return false;
+    }
+
+    inventory->file.fd = fd;
+    attachInventoryFile(inventory, map, size, header.capacity);
+    inventory->slotHandles = slotHandles;
+    inventory->handleSlots = handleSlots;
+    inventory->handleGenerations = handleGenerations;
+    inventory->capacity = header.capacity;
+    inventory->slotCount = header.slotCount;
+    inventory->productCount = header.productCount;
+    inventory->prices.sortedCount = header.priceCount;
+    inventory->names.deferred = true;
+
+    if (!inventory->file.header->clean)
+        recoverInventoryFile(inventory);
+
+    // Marked clean again only once everything is written back on close
+    inventory->file.header->clean = 0;
+    msync(map, INVENTORY_FILE_HEADER, MS_SYNC);
+    return true;
+}
+
+// The products are written in place and survive a crash; the indexes and
+// counts may not, so they are recomputed from the products
+void recoverInventoryFile(Inventory *inventory)
+{
+    PriceIndex *prices = &inventory->prices;
+
+    inventory->productCount = 0;
+    prices->sortedCount = prices->removedCount = 0;
+    memset(inventory->idBuckets, 0, ((size_t)inventory->idBucketMask + 1) * sizeof(IdBucket));
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        Product *product = &inventory->products[slot];
+        if (!isLiveSlot(inventory, slot))
+            continue;
+        inventory->productCount++;
+        indexProductId(inventory, product->productId, slot);
+        prices->sorted[prices->sortedCount].price = product->productPrice;
+        prices->sorted[prices->sortedCount].productId = product->productId;
+        prices->sortedCount++;
+    }
+    qsort(prices->sorted, prices->sortedCount, sizeof(PriceEntry), comparePriceEntries);
+    syncInventoryHeader(inventory);
+}
+
+// Doubling the file moves the index sections: the ID index is rebuilt in
+// its new place and the price run is carried over
+bool growInventoryFile(Inventory *inventory, int capacity)
+{
+    InventoryFile *file = &inventory->file;
+    PriceIndex *prices = &inventory->prices;
+    size_t bucketOffset, priceOffset;
+    size_t size = inventoryFileLayout(capacity, &bucketOffset, &priceOffset);
+
+    PriceEntry *parked = (PriceEntry *)malloc((size_t)(prices->sortedCount > 0 ? prices->sortedCount : 1) *
+                                              sizeof(PriceEntry));
+    if (parked == NULL)
+        return false;
+    memcpy(parked, prices->sorted, (size_t)prices->sortedCount * sizeof(PriceEntry));
+
+    unsigned char *map = MAP_FAILED;
+    if (ftruncate(file->fd, (off_t)size) == 0)
+        map = (unsigned char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        free(parked);
+        return false;
+    }
+
+    munmap(file->map, file->mapSize);
+    attachInventoryFile(inventory, map, size, capacity);
+    memcpy(prices->sorted, parked, (size_t)prices->sortedCount * sizeof(PriceEntry));
+    free(parked);
+
+    memset(inventory->idBuckets, 0, 2 * (size_t)capacity * sizeof(IdBucket));
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (isLiveSlot(inventory, slot))
+            indexProductId(inventory, inventory->products[slot].productId, slot);
+    }
+    file->header->capacity = capacity;
+    return true;
+}
+
+void syncInventoryHeader(Inventory *inventory)
+{
+    InventoryFileHeader *header = inventory->file.header;
+    if (header == NULL)
+        return;
+    header->slotCount = inventory->slotCount;
+    header->productCount = inventory->productCount;
+    header->priceCount = inventory->prices.sortedCount;
+}
+
+// Folds pending prices into the stored run, flushes the dirty pages and
+// only then marks the file clean
+void closeInventoryFile(Inventory *inventory)
+{
+    InventoryFile *file = &inventory->file;
+    if (inventory->prices.pendingCount > 0 || inventory->prices.removedCount > 0)
+        mergePriceEntries(&inventory->prices);
+    syncInventoryHeader(inventory);
+
+    msync(file->map, file->mapSize, MS_SYNC);
+    file->header->clean = 1;
+    msync(file->map, INVENTORY_FILE_HEADER, MS_SYNC);
+    munmap(file->map, file->mapSize);
+    close(file->fd);
+}
+
+// Reads a decimal integer field; false unless the whole field is digits
+bool parseCsvInt(const char *field, const char *end, int *value)
+{
+    long long parsed = 0;
+    if (field == end || end - field > 10)
+        return false;
+    for (; field < end; field++)
+    {
+        if (*field < '0' || *field > '9')
+            return false;
+        parsed = parsed * 10 + (*field - '0');
+    }
+    if (parsed > 2147483647)
+        return false;
+    *value = (int)parsed;
+    return true;
+}
+
+bool parseCsvFloat(const char *field, const char *end, float *value)
+{
+    char text[32], *parsedEnd;
+    if (field == end || end - field >= (long)sizeof(text))
+        return false;
+    memcpy(text, field, (size_t)(end - field));
+    text[end - field] = '\0';
+    *value = strtof(text, &parsedEnd);
+    return *parsedEnd == '\0';
+}
+
+// Parses one "id,name,price,quantity" line without its newline. The name
+// may be double-quoted, with "" for a quote inside it. Returns NULL when
+// the row is valid, or the reason it was rejected.
+const char *parseCsvRow(const char *line, const char *end, Product *product)
+{
+    const char *field = line, *fieldEnd;
+    if (end > line && end[-1] == '\r')
+        end--;
+
+    fieldEnd = memchr(field, ',', (size_t)(end - field));
+    if (fieldEnd == NULL)
+        return "expected 4 fields";
+    if (!parseCsvInt(field, fieldEnd, &product->productId) ||
+        product->productId < 1 || product->productId > MAX_PRODUCT_ID)
+        return "product ID is not a number in the allowed range";
+
+    int length = 0;
+    field = fieldEnd + 1;
+    if (field < end && *field == '"')
+    {
+        for (field++;; field++)
+        {
+            if (field == end)
+                return "unterminated quoted name";
+            if (*field == '"' && (field + 1 == end || field[1] != '"'))
+                break;
+            if (*field == '"')
+                field++;
+            if (length == MAX_NAME_LENGTH - 1)
+                return "name longer than 49 characters";
+            product->productName[length++] = *field;
+        }
+        fieldEnd = field + 1;
+        if (fieldEnd == end || *fieldEnd != ',')
+            return "expected 4 fields";
+    }
+    else
+    {
+        fieldEnd = memchr(field, ',', (size_t)(end - field));
+        if (fieldEnd == NULL)
+            return "expected 4 fields";
+        length = (int)(fieldEnd - field);
+        if (length >= MAX_NAME_LENGTH)
+            return "name longer than 49 characters";
+        memcpy(product->productName, field, (size_t)length);
+    }
+    if (length == 0)
+        return "name is empty";
+    product->productName[length] = '\0';
+
+    field = fieldEnd + 1;
+    fieldEnd = memchr(field, ',', (size_t)(end - field));
+    if (fieldEnd == NULL)
+        return "expected 4 fields";
+    if (!parseCsvFloat(field, fieldEnd, &product->productPrice) ||
+        !(product->productPrice >= 0 && product->productPrice <= 100000))
+        return "price must be a number between 0 and 100000";
+
+    field = fieldEnd + 1;
+    if (memchr(field, ',', (size_t)(end - field)) != NULL)
+        return "expected 4 fields";
+    if (!parseCsvInt(field, end, &product->productQuantity) || product->productQuantity > 1000000)
+        return "quantity must be a number between 0 and 1000000";
+    return NULL;
+}
+
+bool addImportError(ImportChunk *chunk, int line, const char *reason)
+{
+    if (chunk->errorCount == chunk->errorCapacity)
+    {
+        int newCapacity = chunk->errorCapacity > 0 ? 2 * chunk->errorCapacity : 16;
+        ImportError *errors = (ImportError *)realloc(chunk->errors, (size_t)newCapacity * sizeof(ImportError));
+        if (errors == NULL)
+            return false;
+        chunk->errors = errors;
+        chunk->errorCapacity = newCapacity;
+    }
+    chunk->errors[chunk->errorCount].line = line;
+    chunk->errors[chunk->errorCount].reason = reason;
+    chunk->errorCount++;
+    return true;
+}
+
+// Worker: parses and validates every line of its chunk. Line numbers are
+// counted from the start of the chunk and made absolute afterwards.
+void *parseCsvChunk(void *argument)
+{
+    ImportChunk *chunk = (ImportChunk *)argument;
+    for (const char *line = chunk->start; line < chunk->end;)
+    {
+        const char *lineEnd = memchr(line, '\n', (size_t)(chunk->end - line));
+        if (lineEnd == NULL)
+            lineEnd = chunk->end;
+        chunk->lineCount++;
+
+        bool blank = lineEnd == line || (lineEnd - line == 1 && *line == '\r');
+        if (!blank)
+        {
+            if (chunk->rowCount == chunk->rowCapacity)
+            {
+                int newCapacity = chunk->rowCapacity > 0 ? 2 * chunk->rowCapacity : 1024;
+                ImportRow *rows = (ImportRow *)realloc(chunk->rows, (size_t)newCapacity * sizeof(ImportRow));
+                if (rows == NULL)
+                {
+                    chunk->failed = true;
+                    return NULL;
+                }
+                chunk->rows = rows;
+                chunk->rowCapacity = newCapacity;
+            }
+
+            ImportRow *row = &chunk->rows[chunk->rowCount];
+            const char *reason = parseCsvRow(line, lineEnd, &row->product);
+            if (reason == NULL)
+            {
+                row->line = chunk->lineCount;
+                chunk->rowCount++;
+            }
+            else if (!addImportError(chunk, chunk->lineCount, reason))
+            {
+                chunk->failed = true;
+                return NULL;
+            }
+        }
+        line = lineEnd + 1;
+    }
+    return NULL;
+}
+
+int compareImportErrors(const void *first, const void *second)
+{
+    const ImportError *a = (const ImportError *)first, *b = (const ImportError *)second;
+    return (a->line > b->line) - (a->line < b->line);
+}
+
+// Imports the CSV file at path: the file is split at line boundaries and
+// parsed by one thread per core, then the valid rows are appended in file
+// order, IMPORT_BATCH at a time, checking each ID against the index. Bad
+// rows are listed by line number instead of stopping the import.
+bool importCsvFile(Inventory *inventory, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        printf("Could not open %s.\n", path);
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+    if (info.st_size == 0)
+    {
+        printf("%s is empty.\n", path);
+        close(fd);
+        return true;
+    }
+
+    size_t size = (size_t)info.st_size;
+    const char *data = (const char *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("Could not read %s.\n", path);
+        return false;
+    }
+    posix_madvise((void *)data, size, POSIX_MADV_SEQUENTIAL);
+
+    // A first line whose ID field is not a number is a header
+    const char *start = data, *end = data + size;
+    int skippedLines = 0;
+    if (*start < '0' || *start > '9')
+    {
+        const char *firstEnd = memchr(start, '\n', size);
+        start = firstEnd != NULL ? firstEnd + 1 : end;
+        skippedLines = 1;
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCount = cores > 0 ? (int)cores : 1;
+    if (threadCount > IMPORT_MAX_THREADS)
+        threadCount = IMPORT_MAX_THREADS;
+    if ((size_t)(end - start) < (size_t)threadCount * IMPORT_MIN_CHUNK)
+        threadCount = (int)((size_t)(end - start) / IMPORT_MIN_CHUNK) + 1;
+
+    ImportChunk chunks[IMPORT_MAX_THREADS];
+    pthread_t threads[IMPORT_MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    for (int i = 0; i < threadCount; i++)
+    {
+        chunks[i].start = i == 0 ? start : chunks[i - 1].end;
+        const char *split = start + (size_t)(end - start) * (i + 1) / threadCount;
+        if (split < chunks[i].start)
+            split = chunks[i].start;
+        const char *newline = i == threadCount - 1 ? NULL : memchr(split, '\n', (size_t)(end - split));
+        chunks[i].end = newline != NULL ? newline + 1 : end;
+    }
+
+    double began = monotonicMilliseconds();
+    int started = 0;
+    for (; started < threadCount - 1; started++)
+    {
+        if (pthread_create(&threads[started], NULL, parseCsvChunk, &chunks[started]) != 0)
+            break;
+    }
+    for (int i = started; i < threadCount; i++)
+        parseCsvChunk(&chunks[i]); // the caller takes the last chunk, and any that got no thread
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    double parsed = monotonicMilliseconds();
+
+    int rowCount = 0, errorCount = 0, lineBase = skippedLines;
+    bool failed = false;
+    for (int i = 0; i < threadCount; i++)
+    {
+        for (int row = 0; row < chunks[i].rowCount; row++)
+            chunks[i].rows[row].line += lineBase;
+        for (int error = 0; error < chunks[i].errorCount; error++)
+            chunks[i].errors[error].line += lineBase;
+        lineBase += chunks[i].lineCount;
+        rowCount += chunks[i].rowCount;
+        errorCount += chunks[i].errorCount;
+        failed |= chunks[i].failed;
+    }
+
+    // Maintaining the name index row by row would dominate a large import;
+    // let the next name search build it in one pass instead
+    if (rowCount > IMPORT_BATCH && !inventory->names.disabled)
+    {
+        freeNameIndex(&inventory->names);
+        inventory->names.deferred = true;
+    }
+
+    ImportChunk duplicates;
+    memset(&duplicates, 0, sizeof(duplicates));
+    int imported = 0, considered = 0;
+    for (int i = 0; i < threadCount && !failed; i++)
+    {
+        for (int row = 0; row < chunks[i].rowCount && !failed; row++, considered++)
+        {
+            // room for the next batch, or just the rows left when fewer remain
+            int batch = rowCount - considered < IMPORT_BATCH ? rowCount - considered : IMPORT_BATCH;
+            if (considered % IMPORT_BATCH == 0 && !reserveInventory(inventory, inventory->slotCount + batch))
+            {
+                failed = true;
+                break;
+            }
+
+            ImportRow *importRow = &chunks[i].rows[row];
+            if (findProductSlot(inventory, importRow->product.productId) >= 0)
+            {
+                failed = !addImportError(&duplicates, importRow->line, "product ID already exists");
+                errorCount++;
+            }
+            else if (insertProduct(inventory, &importRow->product).index < 0)
+                failed = true;
+            else
+                imported++;
+        }
+    }
+
+    // Parse errors are already in line order; duplicates are merged in
+    ImportError *errors = (ImportError *)malloc((size_t)(errorCount > 0 ? errorCount : 1) * sizeof(ImportError));
+    if (errors != NULL)
+    {
+        int collected = 0;
+        for (int i = 0; i <= threadCount; i++)
+        {
+            ImportChunk *source = i < threadCount ? &chunks[i] : &duplicates;
+            if (source->errorCount > 0)
+                memcpy(&errors[collected], source->errors, (size_t)source->errorCount * sizeof(ImportError));
+            collected += source->errorCount;
+        }
+        qsort(errors, collected, sizeof(ImportError), compareImportErrors);
+        for (int error = 0; error < collected; error++)
+            printf("Line %d: %s\n", errors[error].line, errors[error].reason);
+        free(errors);
+    }
+
+    if (failed)
+        printf("Memory allocation failed, the import stopped early!\n");
+    printf("Imported %d products, rejected %d rows (parsing took %.1f ms on %d thread%s, inserting %.1f ms).\n",
+           imported, errorCount, parsed - began, threadCount, threadCount == 1 ? "" : "s",
+           monotonicMilliseconds() - parsed);
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        free(chunks[i].rows);
+        free(chunks[i].errors);
+    }
+    free(duplicates.errors);
+    munmap((void *)data, size);
+    return !failed;
+}
+
+// Builds the table the order threads read, with one item per live product
+bool startConcurrentInventory(ConcurrentInventory *stock, Inventory *inventory)
+{
+    memset(stock, 0, sizeof(*stock));
+    stock->inventory = inventory;
+    atomic_init(&stock->epoch, 1);
+    for (int reader = 0; reader < MAX_STOCK_READERS; reader++)
+    {
+        atomic_init(&stock->readers[reader].epoch, 0);
+        atomic_init(&stock->readers[reader].used, false);
+    }
+
+    StockTable *table = allocateStockTable(inventory->productCount);
+    if (table == NULL)
+        return false;
+    for (int slot = 0; slot < inventory->slotCount; slot++)
+    {
+        if (!isLiveSlot(inventory, slot))
+            continue;
+        StockItem *item = (StockItem *)malloc(sizeof(StockItem));
+        if (item == NULL)
+        {
+            freeStockTable(table, true);
+            return false;
+        }
+        item->productId = inventory->products[slot].productId;
+        atomic_init(&item->quantity, inventory->products[slot].productQuantity);
+        placeStockItem(table, item);
+    }
+    atomic_init(&stock->table, table);
+    pthread_mutex_init(&stock->writerLock, NULL);
+    return true;
+}
+
+// Writes the quantities back into the inventory; no thread may still be
+// using the concurrent API
+void stopConcurrentInventory(ConcurrentInventory *stock)
+{
+    StockTable *table = atomic_load(&stock->table);
+    for (unsigned int bucket = 0; bucket <= table->bucketMask; bucket++)
+    {
+        StockItem *item = table->buckets[bucket].item;
+        if (item == NULL)
+            continue;
+        int slot = findProductSlot(stock->inventory, item->productId);
+        if (slot >= 0)
+            stock->inventory->products[slot].productQuantity = atomic_load(&item->quantity);
+    }
+    freeStockTable(table, true);
+    pthread_mutex_destroy(&stock->writerLock);
+}
+
+// Room for itemCount items at a load factor of at most one half
+StockTable *allocateStockTable(int itemCount)
+{
+    size_t bucketCount = 16;
+    while (bucketCount < 2 * (size_t)itemCount)
+        bucketCount *= 2;
+    StockTable *table = (StockTable *)calloc(1, sizeof(StockTable) + bucketCount * sizeof(StockBucket));
+    if (table != NULL)
+        table->bucketMask = (unsigned int)(bucketCount - 1);
+    return table;
+}
+
+void placeStockItem(StockTable *table, StockItem *item)
+{
+    unsigned int bucket = hashProductId(item->productId, table->bucketMask);
+    while (table->buckets[bucket].item != NULL)
+        bucket = (bucket + 1) & table->bucketMask;
+    table->buckets[bucket].productId = item->productId;
+    table->buckets[bucket].item = item;
+    table->itemCount++;
+}
+
+StockItem *findStockItem(StockTable *table, int productId)
+{
+    for (unsigned int bucket = hashProductId(productId, table->bucketMask);; bucket = (bucket + 1) & table->bucketMask)
+    {
+        if (table->buckets[bucket].item == NULL)
+            return NULL;
+        if (table->buckets[bucket].productId == productId)
+            return table->buckets[bucket].item;
+    }
+}
+
+void freeStockTable(StockTable *table, bool freeItems)
+{
+    for (unsigned int bucket = 0; freeItems && bucket <= table->bucketMask; bucket++)
+        free(table->buckets[bucket].item);
+    free(table);
+}
+
+// Every thread calling the stock functions needs its own reader slot until
+// it calls leaveStockReaders; returns -1 while all MAX_STOCK_READERS are taken
+int joinStockReaders(ConcurrentInventory *stock)
+{
+    for (int reader = 0; reader < MAX_STOCK_READERS; reader++)
+    {
+        bool used = false;
+        if (atomic_compare_exchange_strong(&stock->readers[reader].used, &used, true))
+            return reader;
+    }
+    return -1;
+}
+
+void leaveStockReaders(ConcurrentInventory *stock, int reader)
+{
+    if (reader < 0 || reader >= MAX_STOCK_READERS)
+        return;
+    atomic_store(&stock->readers[reader].epoch, 0);
+    atomic_store(&stock->readers[reader].used, false);
+}
+
+// A reader announces the epoch it started in before loading the table, so
+// a writer that retires the table afterwards knows to wait for it. Returns
+// NULL for a reader that never got a slot.
+StockTable *enterStockRead(ConcurrentInventory *stock, int reader)
+{
+    if (reader < 0 || reader >= MAX_STOCK_READERS)
+        return NULL;
+    atomic_store(&stock->readers[reader].epoch, atomic_load(&stock->epoch));
+    return atomic_load(&stock->table);
+}
+
+void leaveStockRead(ConcurrentInventory *stock, int reader)
 {
-    int initial_totalProduct;
-    char input_buffer[30];
-    char extraChar;
+    atomic_store(&stock->readers[reader].epoch, 0);
+}
 
-    while (1)
+// Grace period: once every reader that might still see the old table has
+// left its read section, the old table can be freed
+void waitForStockReaders(ConcurrentInventory *stock)
+{
+    unsigned long epoch = atomic_fetch_add(&stock->epoch, 1) + 1;
+    for (int reader = 0; reader < MAX_STOCK_READERS; reader++)
     {
-        printf("Enter the initial number of products (1-100): ");
-        fgets(input_buffer, sizeof(input_buffer), stdin);
-        int scannedItems = sscanf(input_buffer, "%d %c", &initial_totalProduct, &extraChar);
+        unsigned long seen;
+        while ((seen = atomic_load(&stock->readers[reader].epoch)) != 0 && seen < epoch)
+            sched_yield();
+    }
+}
 
-        if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-            (initial_totalProduct >= 1 && initial_totalProduct <= 100))
+// Adds delta to a product's quantity with a compare-and-swap loop. Fails,
+// changing nothing, if the reader has no slot, the product is missing or
+// the result would fall below 0 or rise above 1000000.
+bool changeStock(ConcurrentInventory *stock, int reader, int productId, int delta, int *remaining)
+{
+    StockTable *table = enterStockRead(stock, reader);
+    if (table == NULL)
+        return false;
+    StockItem *item = findStockItem(table, productId);
+    bool changed = false;
+    if (item != NULL)
+    {
+        int quantity = atomic_load(&item->quantity);
+        while (quantity + delta >= 0 && quantity + delta <= 1000000)
         {
-            break;
+            if (atomic_compare_exchange_weak(&item->quantity, &quantity, quantity + delta))
+            {
+                changed = true;
+                quantity += delta;
+                break;
+            }
+            stock->readers[reader].casRetries++;
         }
-        printf("Please enter a number between 1 and 100.\n");
+        if (remaining != NULL)
+            *remaining = quantity;
     }
+    leaveStockRead(stock, reader);
+    return changed;
+}
 
-    Product *inventory = (Product *)calloc(initial_totalProduct, sizeof(Product));
-    if (inventory == NULL)
+// Quantity of a product, or -1 if it does not exist or the reader has no slot
+int readStock(ConcurrentInventory *stock, int reader, int productId)
+{
+    StockTable *table = enterStockRead(stock, reader);
+    if (table == NULL)
+        return -1;
+    StockItem *item = findStockItem(table, productId);
+    int quantity = item != NULL ? atomic_load(&item->quantity) : -1;
+    leaveStockRead(stock, reader);
+    return quantity;
+}
+
+// Writer path: adds the product to the inventory and publishes a copy of
+// the table that includes it. Writers are serialised; readers never wait.
+bool publishProduct(ConcurrentInventory *stock, const Product *product)
+{
+    pthread_mutex_lock(&stock->writerLock);
+    StockTable *old = atomic_load(&stock->table);
+    StockTable *table = allocateStockTable(old->itemCount + 1);
+    StockItem *item = (StockItem *)malloc(sizeof(StockItem));
+    bool published = table != NULL && item != NULL && findProductSlot(stock->inventory, product->productId) < 0 &&
+                     insertProduct(stock->inventory, product).index >= 0;
+    if (!published)
     {
-        printf("Memory allocation failed!\n");
-        return 1;
+        free(table);
+        free(item);
+        pthread_mutex_unlock(&stock->writerLock);
+        return false;
     }
 
-    for (int productNo = 0; productNo < initial_totalProduct; productNo++)
+    for (unsigned int bucket = 0; bucket <= old->bucketMask; bucket++)
     {
-        printf("\nEnter details for product %d:\n", productNo + 1);
-        char userInput[150];
-        char extraChar;
+        if (old->buckets[bucket].item != NULL)
+            placeStockItem(table, old->buckets[bucket].item);
+    }
+    item->productId = product->productId;
+    atomic_init(&item->quantity, product->productQuantity);
+    placeStockItem(table, item);
 
-        // Product ID
-        while (1)
-        {
-            printf("Product ID (1-10000): ");
-            int temp_id;
-            fgets(userInput, sizeof(userInput), stdin);
-            int scannedItems = sscanf(userInput, "%d %c", &temp_id, &extraChar);
+    atomic_store(&stock->table, table);
+    waitForStockReaders(stock);
+    freeStockTable(old, false);
+    stock->tableSwaps++;
+    pthread_mutex_unlock(&stock->writerLock);
+    return true;
+}
 
-            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-                (temp_id >= 1 && temp_id <= 10000))
-            {
-                if (checkIdExist(inventory, productNo , temp_id))
-                {
-                    printf("Product with this ID already exists, Please use a unique ID.\n");
-                    continue;
-                }
-                inventory[productNo].productId = temp_id;
-                break;
-            }
-            else
-                printf("Please enter a number between 1 and 10000.\n");
-        }
+// Writer path: removes the product and publishes a table without it; the
+// item itself is freed once no reader can still hold it
+bool retireProduct(ConcurrentInventory *stock, int productId)
+{
+    pthread_mutex_lock(&stock->writerLock);
+    StockTable *old = atomic_load(&stock->table);
+    StockItem *retired = findStockItem(old, productId);
+    int slot = findProductSlot(stock->inventory, productId);
+    StockTable *table = retired != NULL && slot >= 0 ? allocateStockTable(old->itemCount - 1) : NULL;
+    if (table == NULL)
+    {
+        pthread_mutex_unlock(&stock->writerLock);
+        return false;
+    }
 
-        // Product Name
-        while (1)
-        {
-            printf("Product Name: ");
-            fgets(inventory[productNo].productName, sizeof(inventory[productNo].productName), stdin);
-            inventory[productNo].productName[strcspn(inventory[productNo].productName, "\n")] = '\0';
-            if (strlen(inventory[productNo].productName) >= 1 && strlen(inventory[productNo].productName) <= 50)
-                break;
-            else
-                printf("Please enter a product name (1 to 50 characters): ");
-        }
+    for (unsigned int bucket = 0; bucket <= old->bucketMask; bucket++)
+    {
+        if (old->buckets[bucket].item != NULL && old->buckets[bucket].item != retired)
+            placeStockItem(table, old->buckets[bucket].item);
+    }
+    removeProductAt(stock->inventory, slot);
 
-        // Product Price
-        while (1)
-        {
-            printf("Product Price: ");
-            fgets(userInput, sizeof(userInput), stdin);
-            int scannedItems = sscanf(userInput, "%f %c", &inventory[productNo].productPrice, &extraChar);
+    atomic_store(&stock->table, table);
+    waitForStockReaders(stock);
+    freeStockTable(old, false);
+    free(retired);
+    stock->tableSwaps++;
+    pthread_mutex_unlock(&stock->writerLock);
+    return true;
+}
 
-            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-                (inventory[productNo].productPrice >= 0 && inventory[productNo].productPrice <= 100000))
-                break;
-            else
-                printf("Please enter a product price between 0 and 100000.\n");
-        }
+// Order threads take 1-3 units of random SKUs, mostly the hot ones, and
+// one order in four restocks 1-10 instead; the last two threads add and
+// retire products, which only needs the writer lock, not a reader slot.
+// While draining, order threads only take from the hot SKUs, never
+// restock, and stop once they have seen every hot SKU empty.
+void *runStressThread(void *argument)
+{
+    StressWorker *worker = (StressWorker *)argument;
+    ConcurrentInventory *stock = worker->stock;
+    unsigned int seed = (unsigned int)worker->index * 2654435761u + 1;
+    while (!atomic_load(worker->go))
+        sched_yield();
 
-        // Quantity
-        while (1)
+    if (worker->structural)
+    {
+        for (int round = 0; round < STRESS_CHURN; round++)
         {
-            printf("Enter Quantity (0 - 1000000): ");
-            int newQuantity;
-            char buffer[50], extraChar;
-            fgets(buffer, sizeof(buffer), stdin);
-            int scannedItems = sscanf(buffer, "%d %c", &newQuantity, &extraChar);
-
-            if (scannedItems == 1 && newQuantity >= 0 && newQuantity <= 1000000)
-            {
-                inventory[productNo].productQuantity = newQuantity;
-                break;
-            }
-            printf("Please enter a valid quantity between 0 and 1000000.\n");
+            Product product = {STRESS_PRODUCTS + 1 + worker->index * STRESS_CHURN + round, "Churn", 1, 5};
+            if (publishProduct(stock, &product))
+                worker->churned++;
+            retireProduct(stock, product.productId);
         }
-
-        printf("Product added successfully!\n");
+        return NULL;
     }
 
-    int userChoice;
-    do
+    int reader = joinStockReaders(stock);
+    bool empty[STRESS_HOT_SKUS] = {false};
+    int emptyCount = 0;
+    for (int order = 0; reader >= 0 && (worker->draining ? emptyCount < STRESS_HOT_SKUS : order < STRESS_ORDERS);
+         order++)
     {
-        printf("\n========= INVENTORY MENU =========\n");
-        printf("1. Add New Product\n");
-        printf("2. View All Products\n");
-        printf("3. Update Quantity\n");
-        printf("4. Search Product by ID\n");
-        printf("5. Search Product by Name\n");
-        printf("6. Search Product by Price Range\n");
-        printf("7. Delete Product\n");
-        printf("8. Exit\n");
-
-        while (1)
+        bool hot = worker->draining || rand_r(&seed) % 10 < 9;
+        int productId = hot ? 1 + rand_r(&seed) % STRESS_HOT_SKUS : 1 + rand_r(&seed) % STRESS_PRODUCTS;
+        int remaining = 0;
+        if (!worker->draining && rand_r(&seed) % 4 == 0)
         {
-            printf("Enter your choice: ");
-            char buffer[30], extraChar;
-            fgets(buffer, sizeof(buffer), stdin);
-            int scannedItems = sscanf(buffer, "%d %c", &userChoice, &extraChar);
-            if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-                (userChoice >= 1 && userChoice <= 8))
-                break;
-            printf("Invalid input. Please enter a number between 1 and 8.\n");
+            int amount = 1 + rand_r(&seed) % 10;
+            if (changeStock(stock, reader, productId, amount, &remaining))
+                worker->restocked[productId - 1] += amount;
         }
-
-        switch (userChoice)
+        else
         {
-        case 1:
-            addNewProduct(&inventory, &initial_totalProduct);
-            break;
-        case 2:
-            viewAllProducts(inventory, initial_totalProduct);
-            break;
-        case 3:
-            updateProductQuantity(inventory, initial_totalProduct);
-            break;
-        case 4:
-            searchProductById(inventory, initial_totalProduct);
-            break;
-        case 5:
-            searchProductByName(inventory, initial_totalProduct);
-            break;
-        case 6:
-            searchProductByPriceRange(inventory, initial_totalProduct);
-            break;
-        case 7:
-            deleteProductById(&inventory, &initial_totalProduct);
-            break;
-        case 8:
-            freeInventoryMemory(inventory);
-            printf("Memory released successfully. Exiting program...\n");
-            break;
+            int amount = 1 + rand_r(&seed) % 3;
+            if (changeStock(stock, reader, productId, -amount, &remaining))
+                worker->taken[productId - 1] += amount;
+            else
+                worker->refused++;
+        }
+        if (remaining < 0)
+            worker->negative++;
+        if (worker->draining && remaining == 0 && !empty[productId - 1])
+        {
+            empty[productId - 1] = true;
+            emptyCount++;
         }
-    } while (userChoice != 8);
+        worker->orders++;
+    }
+    leaveStockReaders(stock, reader);
+    return NULL;
+}
 
-    return 0;
+// Runs every worker on its own thread against stock, all released at once,
+// and waits for them; returns the number of threads that started and the
+// time they took from the release
+int runStressPhase(ConcurrentInventory *stock, StressWorker *workers, pthread_t *threads, int threadCount,
+                   bool draining, double *elapsed)
+{
+    _Atomic bool go = false;
+    memset(workers, 0, (size_t)threadCount * sizeof(StressWorker));
+    int started = 0;
+    for (; started < threadCount; started++)
+    {
+        workers[started].stock = stock;
+        workers[started].index = started;
+        workers[started].structural = started >= threadCount - 2;
+        workers[started].draining = draining;
+        workers[started].go = &go;
+        if (pthread_create(&threads[started], NULL, runStressThread, &workers[started]) != 0)
+            break;
+    }
+    double start = monotonicMilliseconds();
+    atomic_store(&go, true);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    *elapsed = monotonicMilliseconds() - start;
+    return started;
 }
 
-void addNewProduct(Product **inventory, int *productCount)
+// Failed compare-and-swaps since the stock started
+long long countStockRetries(const ConcurrentInventory *stock)
 {
-    *inventory = (Product *)realloc(*inventory, (*productCount + 1) * sizeof(Product));
-    if (*inventory == NULL)
+    long long retries = 0;
+    for (int reader = 0; reader < MAX_STOCK_READERS; reader++)
+        retries += stock->readers[reader].casRetries;
+    return retries;
+}
+
+// --stress [threads]: threads hammer a few hot SKUs at once, then every
+// product's final quantity is checked against the units taken and restocked.
+// A second phase drains the hot SKUs from STRESS_DRAIN_STOCK with restocks
+// off, so every order thread races the others down to zero.
+int runStockStressTest(int threadCount)
+{
+    Inventory inventory;
+    ConcurrentInventory stock;
+    if (!initInventory(&inventory, STRESS_PRODUCTS))
     {
-        printf("Memory reallocation failed!\n");
-        return;
+        printf("Memory allocation failed!\n");
+        return 1;
+    }
+    for (int productId = 1; productId <= STRESS_PRODUCTS; productId++)
+    {
+        Product product = {productId, "Stress", 1, productId <= STRESS_HOT_SKUS ? STRESS_HOT_STOCK : 100};
+        insertProduct(&inventory, &product);
+    }
+
+    StressWorker *workers = (StressWorker *)calloc((size_t)threadCount, sizeof(StressWorker));
+    pthread_t *threads = (pthread_t *)malloc((size_t)threadCount * sizeof(pthread_t));
+    if (workers == NULL || threads == NULL || !startConcurrentInventory(&stock, &inventory))
+    {
+        printf("Memory allocation failed!\n");
+        free(workers);
+        free(threads);
+        freeInventoryMemory(&inventory);
+        return 1;
+    }
+
+    double elapsed;
+    int started = runStressPhase(&stock, workers, threads, threadCount, false, &elapsed);
+    long long retries = countStockRetries(&stock);
+    stopConcurrentInventory(&stock);
+
+    long long orders = 0, refused = 0, negative = 0, churned = 0;
+    int mismatches = 0;
+    for (int i = 0; i < started; i++)
+    {
+        orders += workers[i].orders;
+        refused += workers[i].refused;
+        negative += workers[i].negative;
+        churned += workers[i].churned;
+    }
+    for (int productId = 1; productId <= STRESS_PRODUCTS; productId++)
+    {
+        long long expected = productId <= STRESS_HOT_SKUS ? STRESS_HOT_STOCK : 100;
+        for (int i = 0; i < started; i++)
+            expected += workers[i].restocked[productId - 1] - workers[i].taken[productId - 1];
+        Product *product = &inventory.products[findProductSlot(&inventory, productId)];
+        if (product->productQuantity != expected)
+            mismatches++;
+    }
+
+    printf("%d threads, %lld orders in %.1f ms (%.2f M orders/s), %lld refused for lack of stock\n", started,
+           orders, elapsed, orders / elapsed / 1000, refused);
+    printf("%lld compare-and-swap retries (%.2f per order)\n", retries, orders > 0 ? (double)retries / orders : 0.0);
+    printf("%lld products added and retired through %d table swaps, %d products left\n", churned,
+           stock.tableSwaps, inventory.productCount);
+    bool passed = started == threadCount && orders == (long long)(threadCount - 2) * STRESS_ORDERS &&
+                  mismatches == 0 && negative == 0 &&
+                  inventory.productCount == STRESS_PRODUCTS;
+    if (passed)
+        printf("All quantities match the units taken and restocked, none went below zero.\n");
+    else
+        printf("Stress test FAILED: %d quantities wrong, %lld negative readings!\n", mismatches, negative);
+
+    for (int productId = 1; productId <= STRESS_HOT_SKUS; productId++)
+        inventory.products[findProductSlot(&inventory, productId)].productQuantity = STRESS_DRAIN_STOCK;
+    if (!startConcurrentInventory(&stock, &inventory))
+    {
+        printf("Memory allocation failed!\n");
+        free(workers);
+        free(threads);
+        freeInventoryMemory(&inventory);
+        return 1;
+    }
+    started = runStressPhase(&stock, workers, threads, threadCount, true, &elapsed);
+    retries = countStockRetries(&stock);
+    stopConcurrentInventory(&stock);
+
+    orders = refused = negative = 0;
+    int leftOver = 0, miscounted = 0;
+    for (int i = 0; i < started; i++)
+    {
+        orders += workers[i].orders;
+        refused += workers[i].refused;
+        negative += workers[i].negative;
+    }
+    for (int productId = 1; productId <= STRESS_HOT_SKUS; productId++)
+    {
+        long long taken = 0;
+        for (int i = 0; i < started; i++)
+            taken += workers[i].taken[productId - 1];
+        if (inventory.products[findProductSlot(&inventory, productId)].productQuantity != 0)
+            leftOver++;
+        if (taken != STRESS_DRAIN_STOCK)
+            miscounted++;
     }
 
+    printf("Drain: %lld orders emptied %d hot SKUs of %d units each in %.1f ms, %lld refused, %lld retries\n",
+           orders, STRESS_HOT_SKUS, STRESS_DRAIN_STOCK, elapsed, refused, retries);
+    bool drained = started == threadCount && leftOver == 0 && miscounted == 0 && negative == 0;
+    if (drained)
+        printf("Every hot SKU ended at exactly 0 with all %d units taken once, none went below zero.\n",
+               STRESS_DRAIN_STOCK);
+    else
+        printf("Drain FAILED: %d SKUs not empty, %d taken the wrong number of units, %lld negative readings!\n",
+               leftOver, miscounted, negative);
+
+    free(workers);
+    free(threads);
+    freeInventoryMemory(&inventory);
+    return passed && drained ? 0 : 1;
+}
+
+void addNewProduct(Inventory *inventory)
+{
+    Product newProduct;
     char userInput[150];
     char extraChar;
 
     while (1)
     {
-        printf("Product ID (1-10000): ");
+        printf("Product ID (1-%d): ", MAX_PRODUCT_ID);
         int temp_id;
         fgets(userInput, sizeof(userInput), stdin);
         int scannedItems = sscanf(userInput, "%d %c", &temp_id, &extraChar);
 
         if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-            (temp_id >= 1 && temp_id <= 10000))
+            (temp_id >= 1 && temp_id <= MAX_PRODUCT_ID))
         {
-            if (checkIdExist(*inventory, *productCount, temp_id))
+            if (checkIdExist(inventory, temp_id))
             {
                 printf("Product with this ID already exists, Please use a unique ID.\n");
                 continue;
             }
-            (*inventory)[*productCount].productId = temp_id;
+            newProduct.productId = temp_id;
             break;
         }
         else
-            printf("Please enter a number between 1 and 10000.\n");
+            printf("Please enter a number between 1 and %d.\n", MAX_PRODUCT_ID);
     }
 
     while (1)
     {
         printf("Product Name: ");
-        fgets((*inventory)[*productCount].productName, sizeof((*inventory)[*productCount].productName), stdin);
-        (*inventory)[*productCount].productName[strcspn((*inventory)[*productCount].productName, "\n")] = '\0';
-        if (strlen((*inventory)[*productCount].productName) >= 1 && strlen((*inventory)[*productCount].productName) <= 50)
+        fgets(newProduct.productName, sizeof(newProduct.productName), stdin);
+        newProduct.productName[strcspn(newProduct.productName, "\n")] = '\0';
+        if (strlen(newProduct.productName) >= 1 && strlen(newProduct.productName) <= 50)
             break;
         else
             printf("Please enter a product name (1 to 50 characters): ");
@@ -232,10 +2423,10 @@ void addNewProduct(Product **inventory, int *productCount)
     {
         printf("Product Price: ");
         fgets(userInput, sizeof(userInput), stdin);
-        int scannedItems = sscanf(userInput, "%f %c", &(*inventory)[*productCount].productPrice, &extraChar);
+        int scannedItems = sscanf(userInput, "%f %c", &newProduct.productPrice, &extraChar);
 
         if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
-            ((*inventory)[*productCount].productPrice >= 0 && (*inventory)[*productCount].productPrice <= 100000))
+            (newProduct.productPrice >= 0 && newProduct.productPrice <= 100000))
             break;
         else
             printf("Please enter a product price between 0 and 100000.\n");
@@ -251,41 +2442,43 @@ void addNewProduct(Product **inventory, int *productCount)
 
         if (scannedItems == 1 && newQuantity >= 0 && newQuantity <= 1000000)
         {
-            (*inventory)[*productCount].productQuantity = newQuantity;
+            newProduct.productQuantity = newQuantity;
             break;
         }
         printf("Please enter a valid quantity between 0 and 1000000.\n");
     }
 
-    (*productCount)++;
+    if (insertProduct(inventory, &newProduct).index < 0)
+    {
+        printf("Memory reallocation failed!\n");
+        return;
+    }
     printf("Product added successfully!\n");
 }
 
-void viewAllProducts(Product *inventory, int productCount)
+void viewAllProducts(Inventory *inventory)
 {
-    if (productCount == 0)
+    if (inventory->productCount == 0)
     {
         printf("No products available.\n");
         return;
     }
 
     printf("\n========= PRODUCT LIST =========\n");
-    for (int i = 0; i < productCount; i++)
+    for (int i = 0; i < inventory->slotCount; i++)
     {
+        if (!isLiveSlot(inventory, i))
+            continue;
+        Product *product = &inventory->products[i];
         printf("Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
-               inventory[i].productId, inventory[i].productName,
-               inventory[i].productPrice, inventory[i].productQuantity);
+               product->productId, product->productName,
+               product->productPrice, product->productQuantity);
     }
 }
 
-bool checkIdExist(Product *inventory, int productCount, int product_id)
+bool checkIdExist(Inventory *inventory, int product_id)
 {
-    for (int i = 0; i < productCount; i++)
-    {
-        if (product_id == inventory[i].productId)
-            return true;
-    }
-    return false;
+    return findProductSlot(inventory, product_id) >= 0;
 }
 
 void clearInputBuffer()
@@ -295,7 +2488,7 @@ void clearInputBuffer()
         ;
 }
 
-void updateProductQuantity(Product *inventory, int productCount)
+void updateProductQuantity(Inventory *inventory)
 {
     int searchId, newQuantity;
     char buffer[50], extraChar;
@@ -310,29 +2503,29 @@ void updateProductQuantity(Product *inventory, int productCount)
         printf("Invalid input. Please enter a valid Product ID.\n");
     }
 
-    for (int i = 0; i < productCount; i++)
+    int slot = findProductSlot(inventory, searchId);
+    if (slot < 0)
+    {
+        printf("Product with ID %d not found.\n", searchId);
+        return;
+    }
+
+    while (1)
     {
-        if (inventory[i].productId == searchId)
+        printf("Enter new Quantity (0-1000000): ");
+        fgets(buffer, sizeof(buffer), stdin);
+        int scannedItems = sscanf(buffer, "%d %c", &newQuantity, &extraChar);
+        if (scannedItems == 1 && newQuantity >= 0 && newQuantity <= 1000000)
         {
-            while (1)
-            {
-                printf("Enter new Quantity (0-1000000): ");
-                fgets(buffer, sizeof(buffer), stdin);
-                int scannedItems = sscanf(buffer, "%d %c", &newQuantity, &extraChar);
-                if (scannedItems == 1 && newQuantity >= 0 && newQuantity <= 1000000)
-                {
-                    inventory[i].productQuantity = newQuantity;
-                    printf("Quantity updated successfully!\n");
-                    return;
-                }
-                printf("Invalid quantity! Try again.\n");
-            }
+            inventory->products[slot].productQuantity = newQuantity;
+            printf("Quantity updated successfully!\n");
+            return;
         }
+        printf("Invalid quantity! Try again.\n");
     }
-    printf("Product with ID %d not found.\n", searchId);
 }
 
-void searchProductById(Product *inventory, int productCount)
+void searchProductById(Inventory *inventory)
 {
     int searchId;
     char buffer[50], extraChar;
@@ -347,20 +2540,19 @@ void searchProductById(Product *inventory, int productCount)
         printf("Invalid input! Please enter a valid Product ID.\n");
     }
 
-    for (int i = 0; i < productCount; i++)
+    int slot = findProductSlot(inventory, searchId);
+    if (slot < 0)
     {
-        if (inventory[i].productId == searchId)
-        {
-            printf("Product Found: Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
-                   inventory[i].productId, inventory[i].productName,
-                   inventory[i].productPrice, inventory[i].productQuantity);
-            return;
-        }
+        printf("Product not found.\n");
+        return;
     }
-    printf("Product not found.\n");
+    Product *product = &inventory->products[slot];
+    printf("Product Found: Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
+           product->productId, product->productName,
+           product->productPrice, product->productQuantity);
 }
 
-void searchProductByName(Product *inventory, int productCount)
+void searchProductByName(Inventory *inventory)
 {
     char nameSearch[MAX_NAME_LENGTH];
     int found = 0;
@@ -376,23 +2568,30 @@ void searchProductByName(Product *inventory, int productCount)
         printf("Product name cannot be empty.\n");
     }
 
+    int *matches;
+    int matchCount = searchProductNames(inventory, nameSearch, &matches);
+    if (matchCount < 0)
+    {
+        printf("Memory allocation failed!\n");
+        return;
+    }
+
     printf("\nProducts Found:\n");
-    for (int i = 0; i < productCount; i++)
+    for (int i = 0; i < matchCount; i++)
     {
-        if (strstr(inventory[i].productName, nameSearch) != NULL)
-        {
-            printf("Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
-                   inventory[i].productId, inventory[i].productName,
-                   inventory[i].productPrice, inventory[i].productQuantity);
-            found = 1;
-        }
+        Product *product = &inventory->products[matches[i]];
+        printf("Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
+               product->productId, product->productName,
+               product->productPrice, product->productQuantity);
+        found = 1;
     }
+    free(matches);
 
     if (!found)
         printf("No products found matching '%s'.\n", nameSearch);
 }
 
-void searchProductByPriceRange(Product *inventory, int productCount)
+void searchProductByPriceRange(Inventory *inventory)
 {
     float minPrice, maxPrice;
     char buffer[50], extraChar;
@@ -419,59 +2618,119 @@ void searchProductByPriceRange(Product *inventory, int productCount)
     }
 
     printf("Products in price range:\n");
-    for (int i = 0; i < productCount; i++)
+    PriceCursor cursor;
+    openPriceRange(inventory, minPrice, maxPrice, &cursor);
+    for (Product *product = nextInPriceRange(inventory, &cursor); product != NULL;
+         product = nextInPriceRange(inventory, &cursor))
     {
-        if (inventory[i].productPrice >= minPrice && inventory[i].productPrice <= maxPrice)
-        {
-            printf("Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
-                   inventory[i].productId, inventory[i].productName,
-                   inventory[i].productPrice, inventory[i].productQuantity);
-            found = 1;
-        }
+        printf("Product ID: %d | Name: %s | Price: %.2f | Quantity: %d\n",
+               product->productId, product->productName,
+               product->productPrice, product->productQuantity);
+        found = 1;
     }
     if (!found)
         printf("No products found in this price range.\n");
 }
 
-void deleteProductById(Product **inventory, int *productCount)
+void updateProductPrice(Inventory *inventory)
 {
-    int deleteId;
+    int searchId;
+    float newPrice;
     char buffer[50], extraChar;
 
     while (1)
     {
-        printf("Enter Product ID to delete: ");
+        printf("Enter Product ID to update price: ");
         fgets(buffer, sizeof(buffer), stdin);
-        int scannedItems = sscanf(buffer, "%d %c", &deleteId, &extraChar);
+        int scannedItems = sscanf(buffer, "%d %c", &searchId, &extraChar);
         if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')))
             break;
-        printf("Invalid input! Please enter a valid Product ID.\n");
+        printf("Invalid input. Please enter a valid Product ID.\n");
     }
 
-    for (int i = 0; i < *productCount; i++)
+    int slot = findProductSlot(inventory, searchId);
+    if (slot < 0)
     {
-        if ((*inventory)[i].productId == deleteId)
-        {
-            for (int j = i; j < *productCount - 1; j++)
-                (*inventory)[j] = (*inventory)[j + 1];
+        printf("Product with ID %d not found.\n", searchId);
+        return;
+    }
 
-            (*productCount)--;
+    while (1)
+    {
+        printf("Enter new Price (0-100000): ");
+        fgets(buffer, sizeof(buffer), stdin);
+        int scannedItems = sscanf(buffer, "%f %c", &newPrice, &extraChar);
+        if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')) &&
+            (newPrice >= 0 && newPrice <= 100000))
+            break;
+        printf("Invalid price! Try again.\n");
+    }
 
-            *inventory = (Product *)realloc(*inventory, (*productCount) * sizeof(Product));
-            if (*inventory == NULL && *productCount > 0)
-            {
-                fprintf(stderr, "Memory reallocation failed during delete!\n");
-                return;
-            }
+    if (!setProductPrice(inventory, slot, newPrice))
+    {
+        printf("Memory reallocation failed!\n");
+        return;
+    }
+    printf("Price updated successfully!\n");
+}
 
-            printf("Product deleted successfully!\n");
+void importProductsFromCsv(Inventory *inventory)
+{
+    char path[256];
+
+    while (1)
+    {
+        printf("Enter CSV file to import (id,name,price,quantity per line): ");
+        if (fgets(path, sizeof(path), stdin) == NULL)
             return;
-        }
+        path[strcspn(path, "\n")] = '\0';
+        if (strlen(path) > 0)
+            break;
+        printf("File name cannot be empty.\n");
+    }
+    importCsvFile(inventory, path);
+}
+
+void deleteProductById(Inventory *inventory)
+{
+    int deleteId;
+    char buffer[50], extraChar;
+
+    while (1)
+    {
+        printf("Enter Product ID to delete: ");
+        fgets(buffer, sizeof(buffer), stdin);
+        int scannedItems = sscanf(buffer, "%d %c", &deleteId, &extraChar);
+        if ((scannedItems == 1 || (scannedItems == 2 && extraChar == '\n')))
+            break;
+        printf("Invalid input! Please enter a valid Product ID.\n");
+    }
+
+    int slot = findProductSlot(inventory, deleteId);
+    if (slot < 0)
+    {
+        printf("Product with ID %d not found.\n", deleteId);
+        return;
     }
-    printf("Product with ID %d not found.\n", deleteId);
+
+    removeProductAt(inventory, slot);
+    printf("Product deleted successfully!\n");
 }
 
-void freeInventoryMemory(Product *inventory)
+void freeInventoryMemory(Inventory *inventory)
 {
-    free(inventory);
+    if (inventory->file.map != NULL)
+        closeInventoryFile(inventory);
+    else
+    {
+        free(inventory->products);
+        free(inventory->idBuckets);
+        free(inventory->prices.sorted);
+    }
+    free(inventory->slotHandles);
+    free(inventory->handleSlots);
+    free(inventory->handleGenerations);
+    free(inventory->prices.pending);
+    freeNameIndex(&inventory->names);
+    memset(inventory, 0, sizeof(*inventory));
 }